@@ -0,0 +1,148 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_object_fusion_to_detected_object/loanable_publisher.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "synthetic_scene.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include "autoware_auto_perception_msgs/msg/detected_objects.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace radar_fusion_to_detected_object
+{
+namespace
+{
+using autoware_auto_perception_msgs::msg::DetectedObjects;
+using namespace std::chrono_literals;
+
+constexpr unsigned int kSeed = 42;
+
+// Subscriber node spun in its own thread, which notifies the reception of each message
+class LatencySubscriber
+{
+public:
+  explicit LatencySubscriber(const std::string & topic)
+  : node_(std::make_shared<rclcpp::Node>(
+      "publish_latency_subscriber", rclcpp::NodeOptions().use_intra_process_comms(false)))
+  {
+    subscription_ = node_->create_subscription<DetectedObjects>(
+      topic, rclcpp::QoS{1}.reliable(), [this](const DetectedObjects::ConstSharedPtr msg) {
+        benchmark::DoNotOptimize(msg->objects.size());
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          ++num_received_;
+        }
+        cv_.notify_one();
+      });
+    executor_.add_node(node_);
+    thread_ = std::thread([this] { executor_.spin(); });
+  }
+
+  ~LatencySubscriber()
+  {
+    executor_.cancel();
+    thread_.join();
+  }
+
+  // Wait until the number of received messages reaches num_received. Return false on timeout.
+  bool waitFor(const std::size_t num_received)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, 1s, [&] { return num_received_ >= num_received; });
+  }
+
+  std::size_t getNumReceived()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_received_;
+  }
+
+private:
+  rclcpp::Node::SharedPtr node_;
+  rclcpp::Subscription<DetectedObjects>::SharedPtr subscription_{};
+  rclcpp::executors::SingleThreadedExecutor executor_{};
+  std::thread thread_{};
+  std::mutex mutex_{};
+  std::condition_variable cv_{};
+  std::size_t num_received_{0};
+};
+
+// Time from writing fused objects into the output message to the reception in another node.
+// Intra-process communication is disabled, so that messages go through the middleware as between
+// processes on the same machine. If the middleware does not support loaning, the loaned case falls
+// back to the normal publish, which is reported by the "loaned" counter and the label.
+// DetectedObjects has unbounded sequences, so that it is not loaned by any middleware so far.
+// Args: num_objects, use_loaned_message
+void BM_PublishLatency(benchmark::State & state)
+{
+  const std::string topic = "/publish_latency_benchmark/objects";
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = static_cast<std::size_t>(state.range(0));
+  const auto scene = generateSyntheticScene(scene_param);
+  const auto & objects = *scene->input.objects;
+
+  auto node = std::make_shared<rclcpp::Node>(
+    "publish_latency_publisher", rclcpp::NodeOptions().use_intra_process_comms(false));
+  auto publisher = node->create_publisher<DetectedObjects>(topic, rclcpp::QoS{1}.reliable());
+  LoanablePublisher<DetectedObjects> loanable_publisher(publisher, state.range(1) != 0);
+  LatencySubscriber subscriber(topic);
+
+  // Wait for discovery
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (publisher->get_subscription_count() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(10ms);
+  }
+
+  for (auto _ : state) {
+    const std::size_t num_received = subscriber.getNumReceived();
+    const auto start = std::chrono::steady_clock::now();
+    loanable_publisher.borrow() = objects;
+    loanable_publisher.publish();
+    if (!subscriber.waitFor(num_received + 1)) {
+      state.SkipWithError("Timeout to receive a message");
+      break;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+  }
+  state.counters["loaned"] = loanable_publisher.isLoanable() ? 1.0 : 0.0;
+  if (state.range(1) != 0 && !loanable_publisher.isLoanable()) {
+    state.SetLabel("not loanable, fell back to normal publish");
+  }
+}
+BENCHMARK(BM_PublishLatency)
+  ->ArgNames({"objects", "loaned"})
+  ->ArgsProduct({{10, 50, 200}, {0, 1}})
+  ->UseManualTime();
+}  // namespace
+}  // namespace radar_fusion_to_detected_object
+
+int main(int argc, char ** argv)
+{
+  rclcpp::init(argc, argv);
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,406 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_fusion_to_detected_object.hpp"
+#include "synthetic_scene.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+// Count allocations from the global allocator to report allocations per cycle
+namespace
+{
+std::atomic<std::size_t> g_num_allocations{0};
+}  // namespace
+
+// Not inlined so that the compiler does not pair malloc() and free() with new and delete
+__attribute__((noinline)) void * operator new(std::size_t size)
+{
+  g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void * ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+__attribute__((noinline)) void operator delete(void * ptr) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete(void * ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace radar_fusion_to_detected_object
+{
+namespace
+{
+constexpr unsigned int kSeed = 42;
+
+enum WeightConfig : int64_t {
+  MIN_DISTANCE = 0,
+  MEDIAN = 1,
+  TARGET_VALUE = 2,
+  ALL = 3,
+  MIN_DISTANCE_TOP_TARGET_VALUE = 4
+};
+
+RadarFusionToDetectedObject::Param createParam(const int64_t weight_config, const bool use_grid)
+{
+  RadarFusionToDetectedObject::Param param{};
+  param.bounding_box_margin = 2.0;
+  param.split_threshold_velocity = 5.0;
+  param.threshold_yaw_diff = 0.35;
+  param.use_grid_index = use_grid;
+  param.grid_cell_size = 4.0;
+  param.threshold_probability = 0.4f;
+  switch (weight_config) {
+    case MEDIAN:
+      param.velocity_weight_median = 1.0;
+      break;
+    case TARGET_VALUE:
+      param.velocity_weight_average = 1.0;
+      param.velocity_weight_target_value_average = 1.0;
+      param.velocity_weight_target_value_top = 1.0;
+      break;
+    case ALL:
+      param.velocity_weight_average = 1.0;
+      param.velocity_weight_median = 1.0;
+      param.velocity_weight_min_distance = 1.0;
+      param.velocity_weight_target_value_average = 1.0;
+      param.velocity_weight_target_value_top = 1.0;
+      break;
+    case MIN_DISTANCE_TOP_TARGET_VALUE:
+      param.velocity_weight_min_distance = 1.0;
+      param.velocity_weight_target_value_top = 1.0;
+      break;
+    default:
+      param.velocity_weight_min_distance = 1.0;
+      break;
+  }
+  return param;
+}
+
+void setCounters(
+  benchmark::State & state, const SceneParam & scene_param, const std::size_t num_allocations)
+{
+  using benchmark::Counter;
+  const auto num_objects = static_cast<double>(scene_param.num_objects);
+  const auto num_radars = static_cast<double>(scene_param.num_radars);
+  state.counters["time_per_object"] =
+    Counter(num_objects, Counter::kIsIterationInvariantRate | Counter::kInvert);
+  state.counters["time_per_radar"] =
+    Counter(num_radars, Counter::kIsIterationInvariantRate | Counter::kInvert);
+  state.counters["allocs_per_cycle"] =
+    Counter(static_cast<double>(num_allocations), Counter::kAvgIterations);
+}
+
+void runUpdate(
+  benchmark::State & state, const SceneParam & scene_param, const int64_t weight_config,
+  const bool use_grid, const int num_threads = 1, const bool convert_doppler_to_twist = false,
+  const bool use_single_precision = false)
+{
+  const auto scene = generateSyntheticScene(scene_param);
+  RadarFusionToDetectedObject fusion;
+  auto param = createParam(weight_config, use_grid);
+  param.num_threads = num_threads;
+  param.convert_doppler_to_twist = convert_doppler_to_twist;
+  param.use_single_precision = use_single_precision;
+  fusion.setParam(param);
+
+  // Warm up buffers reused over cycles
+  benchmark::DoNotOptimize(fusion.update(scene->input));
+
+  const std::size_t num_allocations_start = g_num_allocations.load();
+  for (auto _ : state) {
+    auto output = fusion.update(scene->input);
+    benchmark::DoNotOptimize(output);
+  }
+  setCounters(state, scene_param, g_num_allocations.load() - num_allocations_start);
+  state.counters["arena_upstream_allocs"] =
+    static_cast<double>(fusion.getArenaUpstreamAllocationCount());
+}
+
+// Args: num_objects, num_radars, use_grid
+void BM_Update(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = static_cast<std::size_t>(state.range(0));
+  scene_param.num_radars = static_cast<std::size_t>(state.range(1));
+  runUpdate(state, scene_param, MIN_DISTANCE, state.range(2) != 0);
+}
+BENCHMARK(BM_Update)
+  ->ArgNames({"objects", "radars", "grid"})
+  ->ArgsProduct({{10, 50, 200}, {100, 500, 2000}, {0, 1}});
+
+// Args: object_length [dm], use_grid
+void BM_UpdateBoxSize(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 50;
+  scene_param.num_radars = 500;
+  scene_param.object_length = static_cast<double>(state.range(0)) / 10.0;
+  runUpdate(state, scene_param, MIN_DISTANCE, state.range(1) != 0);
+}
+BENCHMARK(BM_UpdateBoxSize)
+  ->ArgNames({"length_dm", "grid"})
+  ->ArgsProduct({{20, 45, 120, 200}, {0, 1}});
+
+// Args: cluster_ratio [%], use_grid
+void BM_UpdateClustering(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 50;
+  scene_param.num_radars = 500;
+  scene_param.cluster_ratio = static_cast<double>(state.range(0)) / 100.0;
+  runUpdate(state, scene_param, MIN_DISTANCE, state.range(1) != 0);
+}
+BENCHMARK(BM_UpdateClustering)
+  ->ArgNames({"cluster_pct", "grid"})
+  ->ArgsProduct({{0, 25, 50, 90}, {0, 1}});
+
+// Args: weight_config
+void BM_UpdateWeights(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 50;
+  scene_param.num_radars = 500;
+  scene_param.cluster_ratio = 0.9;
+  runUpdate(state, scene_param, state.range(0), true);
+}
+BENCHMARK(BM_UpdateWeights)
+  ->ArgNames({"weights"})
+  ->DenseRange(MIN_DISTANCE, MIN_DISTANCE_TOP_TARGET_VALUE);
+
+// Args: num_threads, use_grid
+void BM_UpdateThreads(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 200;
+  scene_param.num_radars = 2000;
+  runUpdate(state, scene_param, ALL, state.range(1) != 0, static_cast<int>(state.range(0)));
+}
+BENCHMARK(BM_UpdateThreads)
+  ->ArgNames({"threads", "grid"})
+  ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+  ->UseRealTime();
+
+// Args: num_radars, convert_doppler_to_twist
+void BM_UpdateScan(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 100;
+  scene_param.num_radars = static_cast<std::size_t>(state.range(0));
+  scene_param.use_radar_scan = true;
+  runUpdate(state, scene_param, MEDIAN, true, 1, state.range(1) != 0);
+}
+BENCHMARK(BM_UpdateScan)
+  ->ArgNames({"radars", "doppler"})
+  ->ArgsProduct({{2000, 10000, 20000}, {0, 1}});
+
+// Args: num_objects, in_place
+// The in-place update takes objects refilled out of the timed region, as a node receiving a new
+// message every cycle, so that only the copy of objects in update() is compared.
+void BM_UpdateInPlace(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = static_cast<std::size_t>(state.range(0));
+  scene_param.num_radars = 2000;
+  scene_param.cluster_ratio = 0.9;
+  const bool in_place = state.range(1) != 0;
+  const auto scene = generateSyntheticScene(scene_param);
+  RadarFusionToDetectedObject fusion;
+  fusion.setParam(createParam(ALL, true));
+
+  DetectedObjects objects = *scene->input.objects;
+  benchmark::DoNotOptimize(fusion.update(scene->input, objects));
+
+  std::size_t num_allocations = 0;
+  for (auto _ : state) {
+    if (in_place) {
+      state.PauseTiming();
+      objects = *scene->input.objects;
+      state.ResumeTiming();
+      const std::size_t num_allocations_start = g_num_allocations.load();
+      benchmark::DoNotOptimize(fusion.update(scene->input, objects));
+      num_allocations += g_num_allocations.load() - num_allocations_start;
+    } else {
+      const std::size_t num_allocations_start = g_num_allocations.load();
+      auto output = fusion.update(scene->input);
+      benchmark::DoNotOptimize(output);
+      num_allocations += g_num_allocations.load() - num_allocations_start;
+    }
+  }
+  setCounters(state, scene_param, num_allocations);
+}
+BENCHMARK(BM_UpdateInPlace)
+  ->ArgNames({"objects", "in_place"})
+  ->ArgsProduct({{50, 200, 1000}, {0, 1}});
+
+// Args: num_radars, use_grid, use_single_precision
+void BM_UpdatePrecision(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 200;
+  scene_param.num_radars = static_cast<std::size_t>(state.range(0));
+  scene_param.cluster_ratio = 0.9;
+  runUpdate(state, scene_param, ALL, state.range(1) != 0, 1, false, state.range(2) != 0);
+}
+BENCHMARK(BM_UpdatePrecision)
+  ->ArgNames({"radars", "grid", "single"})
+  ->ArgsProduct({{500, 2000, 10000}, {0, 1}, {0, 1}});
+
+// Args: num_radars, use_grid, use_single_precision
+void BM_FilterRadarWithinObject(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 50;
+  scene_param.num_radars = static_cast<std::size_t>(state.range(0));
+  const bool use_grid = state.range(1) != 0;
+  const auto scene = generateSyntheticScene(scene_param);
+  const auto & radars = scene->radar_batch;
+  RadarFusionToDetectedObject::BasicRadarBatch<float> radars_f{};
+  radars_f.assign(radars);
+
+  RadarFusionToDetectedObject fusion;
+  fusion.setParam(createParam(MIN_DISTANCE, use_grid));
+  RadarGridIndex grid_index{};
+  grid_index.build(
+    radars.size(),
+    [&radars](const std::size_t i, double & x, double & y) {
+      x = radars.x[i];
+      y = radars.y[i];
+    },
+    4.0);
+  RadarFusionToDetectedObject::RadarIndices indices{std::pmr::new_delete_resource()};
+  indices.reserve(radars.size());
+
+  auto run = [&](const auto & batch) {
+    for (auto _ : state) {
+      for (const auto & object : scene->input.objects->objects) {
+        fusion.filterRadarWithinObject(object, batch, use_grid ? &grid_index : nullptr, indices);
+        benchmark::DoNotOptimize(indices.data());
+      }
+    }
+  };
+  const std::size_t num_allocations_start = g_num_allocations.load();
+  if (state.range(2) != 0) {
+    run(radars_f);
+  } else {
+    run(radars);
+  }
+  setCounters(state, scene_param, g_num_allocations.load() - num_allocations_start);
+}
+BENCHMARK(BM_FilterRadarWithinObject)
+  ->ArgNames({"radars", "grid", "single"})
+  ->ArgsProduct({{100, 500, 2000, 10000}, {0, 1}, {0, 1}});
+
+// Args: num_radars within object, weight_config, use_single_precision
+void BM_EstimateTwist(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 1;
+  scene_param.num_radars = static_cast<std::size_t>(state.range(0));
+  scene_param.cluster_ratio = 1.0;
+  const auto scene = generateSyntheticScene(scene_param);
+  const auto & object = scene->input.objects->objects.front();
+
+  RadarFusionToDetectedObject fusion;
+  fusion.setParam(createParam(state.range(1), false));
+  RadarFusionToDetectedObject::RadarIndices indices{std::pmr::new_delete_resource()};
+  for (std::size_t i = 0; i < scene->radar_batch.size(); ++i) {
+    indices.push_back(i);
+  }
+
+  RadarFusionToDetectedObject::BasicRadarBatch<float> radars_f{};
+  radars_f.assign(scene->radar_batch);
+
+  auto run = [&](const auto & batch) {
+    // Warm up the scratch buffer of the median
+    benchmark::DoNotOptimize(fusion.estimateTwist(object, batch, indices));
+
+    const std::size_t num_allocations_start = g_num_allocations.load();
+    for (auto _ : state) {
+      auto twist = fusion.estimateTwist(object, batch, indices);
+      benchmark::DoNotOptimize(twist);
+    }
+    setCounters(state, scene_param, g_num_allocations.load() - num_allocations_start);
+  };
+  if (state.range(2) != 0) {
+    run(radars_f);
+  } else {
+    run(scene->radar_batch);
+  }
+}
+BENCHMARK(BM_EstimateTwist)
+  ->ArgNames({"radars", "weights", "single"})
+  ->ArgsProduct(
+    {{4, 16, 64, 256},
+     {MIN_DISTANCE, MEDIAN, TARGET_VALUE, ALL, MIN_DISTANCE_TOP_TARGET_VALUE},
+     {0, 1}});
+
+// Transform of radar data from a corner radar frame into the frame of objects, which is done once
+// per sensor and cycle in the nodes.
+// Args: num_radars, use_single_precision
+void BM_TransformRadarBatch(benchmark::State & state)
+{
+  SceneParam scene_param{};
+  scene_param.seed = kSeed;
+  scene_param.num_objects = 0;
+  scene_param.num_radars = static_cast<std::size_t>(state.range(0));
+  const auto scene = generateSyntheticScene(scene_param);
+  const Eigen::Isometry3d transform = Eigen::Translation3d(3.5, 0.8, 0.6) *
+                                      Eigen::AngleAxisd(M_PI / 4.0, Eigen::Vector3d::UnitZ());
+
+  auto run = [&](auto & batch) {
+    for (auto _ : state) {
+      batch.transform(transform, 0, batch.size());
+      benchmark::DoNotOptimize(batch.x.data());
+      benchmark::ClobberMemory();
+    }
+    state.counters["time_per_radar"] = benchmark::Counter(
+      static_cast<double>(batch.size()),
+      benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+  };
+  if (state.range(1) != 0) {
+    RadarFusionToDetectedObject::BasicRadarBatch<float> radars_f{};
+    radars_f.assign(scene->radar_batch);
+    run(radars_f);
+  } else {
+    auto radars = scene->radar_batch;
+    run(radars);
+  }
+}
+BENCHMARK(BM_TransformRadarBatch)
+  ->ArgNames({"radars", "single"})
+  ->ArgsProduct({{100, 2000, 20000}, {0, 1}});
+}  // namespace
+}  // namespace radar_fusion_to_detected_object
+
+BENCHMARK_MAIN();
@@ -0,0 +1,407 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Offline replay of recorded detected objects and radar objects through the fusion of
+// RadarObjectFusionToDetectedObjectNode without an executor.
+//
+// Usage:
+//   radar_object_fusion_replay <bag> [--objects-topic <topic>] [--radars-topic <topic> ...]
+//     [--odometry-topic <topic>] [--checksum-file <path>] [--ros-args --params-file <yaml> ...]
+//
+// Messages are loaded into memory first and replayed as fast as possible. Fusion is triggered by
+// detected objects in the "object" mode, and by simulated timer on the recorded time in the "timer"
+// mode. Output checksums of each frame are written to the checksum file, so that parameter sets and
+// code versions can be compared on identical input.
+// --radars-topic is given for each radar sensor in order. Radar objects are transformed with /tf
+// and /tf_static in the bag. Pairing, conversion and fusion are done by RadarObjectFusionCycle,
+// which the node also uses.
+
+#include "radar_fusion_to_detected_object.hpp"
+#include "radar_object_fusion_to_detected_object/radar_object_fusion_cycle.hpp"
+#include "radar_object_fusion_to_detected_object/radar_object_fusion_to_detected_object_node.hpp"
+#include "radar_object_fusion_to_detected_object/sliding_window_statistics.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rclcpp/serialization.hpp"
+#include "rosbag2_cpp/reader.hpp"
+#include "tf2/buffer_core.h"
+
+#include "autoware_auto_perception_msgs/msg/detected_objects.hpp"
+#include "autoware_auto_perception_msgs/msg/tracked_objects.hpp"
+#include "nav_msgs/msg/odometry.hpp"
+#include "tf2_msgs/msg/tf_message.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+namespace
+{
+using autoware_auto_perception_msgs::msg::DetectedObjects;
+using autoware_auto_perception_msgs::msg::TrackedObjects;
+using nav_msgs::msg::Odometry;
+using tf2_msgs::msg::TFMessage;
+
+struct ReplayOption
+{
+  std::string bag_uri{};
+  std::string objects_topic{"/perception/object_recognition/detection/objects"};
+  // Topics of radar objects of each sensor
+  std::vector<std::string> radars_topics{};
+  std::string odometry_topic{"/localization/kinematic_state"};
+  std::string checksum_file{};
+};
+
+// Message in the order of the recorded time
+struct ReplayEvent
+{
+  int64_t time_ns{};
+  DetectedObjects::SharedPtr objects{};
+  TrackedObjects::ConstSharedPtr radar_objects{};
+  std::size_t radar_index{};
+  Odometry::ConstSharedPtr odometry{};
+  TFMessage::ConstSharedPtr transforms{};
+  bool is_static_transforms{false};
+};
+
+struct FrameResult
+{
+  int64_t stamp_ns{};
+  std::size_t num_objects{};
+  uint64_t checksum{};
+};
+
+template <class MsgT>
+std::shared_ptr<MsgT> deserialize(const rosbag2_storage::SerializedBagMessage & bag_message)
+{
+  static rclcpp::Serialization<MsgT> serialization;
+  rclcpp::SerializedMessage serialized_message(*bag_message.serialized_data);
+  auto msg = std::make_shared<MsgT>();
+  serialization.deserialize_message(&serialized_message, msg.get());
+  return msg;
+}
+
+std::vector<ReplayEvent> readBag(const ReplayOption & option)
+{
+  rosbag2_cpp::Reader reader;
+  reader.open(option.bag_uri);
+
+  std::vector<ReplayEvent> events;
+  while (reader.has_next()) {
+    const auto bag_message = reader.read_next();
+    ReplayEvent event{};
+    event.time_ns = bag_message->time_stamp;
+    const auto & topic = bag_message->topic_name;
+    const auto radars_topic =
+      std::find(option.radars_topics.begin(), option.radars_topics.end(), topic);
+    if (topic == option.objects_topic) {
+      event.objects = deserialize<DetectedObjects>(*bag_message);
+    } else if (radars_topic != option.radars_topics.end()) {
+      event.radar_objects = deserialize<TrackedObjects>(*bag_message);
+      event.radar_index = static_cast<std::size_t>(radars_topic - option.radars_topics.begin());
+    } else if (topic == option.odometry_topic) {
+      event.odometry = deserialize<Odometry>(*bag_message);
+    } else if (topic == "/tf" || topic == "/tf_static") {
+      event.transforms = deserialize<TFMessage>(*bag_message);
+      event.is_static_transforms = topic == "/tf_static";
+    } else {
+      continue;
+    }
+    events.push_back(std::move(event));
+  }
+  return events;
+}
+
+// FNV-1a hash of fused objects, which changes if any output field used downstream changes
+class Checksum
+{
+public:
+  void add(const void * data, const std::size_t size)
+  {
+    const auto * bytes = static_cast<const uint8_t *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash_ = (hash_ ^ bytes[i]) * 1099511628211ULL;
+    }
+  }
+  template <class T>
+  void add(const T & value)
+  {
+    add(&value, sizeof(T));
+  }
+  uint64_t get() const { return hash_; }
+
+private:
+  uint64_t hash_{14695981039346656037ULL};
+};
+
+uint64_t calcChecksum(const DetectedObjects & objects)
+{
+  Checksum checksum{};
+  checksum.add(objects.objects.size());
+  for (const auto & object : objects.objects) {
+    checksum.add(object.existence_probability);
+    for (const auto & classification : object.classification) {
+      checksum.add(classification.label);
+      checksum.add(classification.probability);
+    }
+    const auto & kinematics = object.kinematics;
+    const auto & position = kinematics.pose_with_covariance.pose.position;
+    checksum.add(position.x);
+    checksum.add(position.y);
+    checksum.add(position.z);
+    checksum.add(kinematics.has_twist);
+    const auto & linear = kinematics.twist_with_covariance.twist.linear;
+    checksum.add(linear.x);
+    checksum.add(linear.y);
+    checksum.add(linear.z);
+    checksum.add(kinematics.twist_with_covariance.twist.angular.z);
+  }
+  return checksum.get();
+}
+
+// The same pairing and fusion as RadarObjectFusionToDetectedObjectNode except publishing
+class FusionReplay
+{
+public:
+  using NodeParam = RadarObjectFusionToDetectedObjectNode::NodeParam;
+  using Result = RadarObjectFusionCycle::Pairing::Result;
+
+  FusionReplay(
+    const NodeParam & node_param, const RadarFusionToDetectedObject::Param & core_param,
+    const std::size_t num_radars)
+  : node_param_(node_param),
+    fusion_cycle_(createCycleParam(node_param, num_radars), tf_buffer_)
+  {
+    fusion_cycle_.setCoreParam(core_param);
+  }
+
+  void run(std::vector<ReplayEvent> & events)
+  {
+    const bool is_timer_mode = node_param_.trigger_mode == "timer";
+    const auto update_period_ns = static_cast<int64_t>(1e9 / node_param_.update_rate_hz);
+    int64_t next_timer_ns = events.empty() ? 0 : events.front().time_ns + update_period_ns;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto & event : events) {
+      // Timer fires on the recorded time before the message is received
+      while (is_timer_mode && next_timer_ns <= event.time_ns) {
+        fuseIfReady(next_timer_ns);
+        next_timer_ns += update_period_ns;
+      }
+
+      if (event.objects) {
+        ++num_objects_;
+        // Detected objects not output yet are output before replaced by newer ones
+        if (fusion_cycle_.getPairing().hasPendingObjects()) {
+          fuseIfReady(event.time_ns, true);
+        }
+        fusion_cycle_.setObjects(std::move(event.objects));
+        if (!is_timer_mode) {
+          fuseIfReady(event.time_ns);
+        }
+      } else if (event.radar_objects) {
+        fusion_cycle_.pushRadar(event.radar_objects, event.radar_index);
+      } else if (event.odometry) {
+        fusion_cycle_.setOdometry(event.odometry);
+      } else if (event.transforms) {
+        for (const auto & transform : event.transforms->transforms) {
+          tf_buffer_.setTransform(
+            transform, "radar_object_fusion_replay", event.is_static_transforms);
+        }
+        if (event.is_static_transforms) {
+          fusion_cycle_.clearTransformCache();
+        }
+      }
+    }
+    if (!events.empty()) {
+      fuseIfReady(events.back().time_ns, true);
+    }
+    wall_time_sec_ =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void report(const std::string & checksum_file) const
+  {
+    std::vector<double> sorted_latencies = latencies_ms_;
+    std::sort(sorted_latencies.begin(), sorted_latencies.end());
+    Checksum total_checksum{};
+    for (const auto & frame : frames_) {
+      total_checksum.add(frame.checksum);
+    }
+
+    // Detected objects are dropped if they are replaced before any radar objects are received
+    const double num_frames = static_cast<double>(frames_.size());
+    std::printf(
+      "frames: %zu (fused %zu, unmatched %zu, not fused %zu), dropped %zu of %zu objects\n",
+      frames_.size(), num_fused_, num_unmatched_, num_not_fused_, num_objects_ - frames_.size(),
+      num_objects_);
+    std::printf(
+      "skipped radar sensors: %zu (untransformed %zu)\n", num_skipped_sensors_,
+      num_untransformed_sensors_);
+    std::printf(
+      "wall time: %.3f [s], %.1f frames/s\n", wall_time_sec_, num_frames / wall_time_sec_);
+    std::printf(
+      "latency [ms]: p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+      getNearestRankPercentile(sorted_latencies, 0.50),
+      getNearestRankPercentile(sorted_latencies, 0.90),
+      getNearestRankPercentile(sorted_latencies, 0.99),
+      sorted_latencies.empty() ? 0.0 : sorted_latencies.back());
+    std::printf("checksum: %016" PRIx64 "\n", total_checksum.get());
+    if (!last_transform_error_.empty()) {
+      std::printf("last transform error: %s\n", last_transform_error_.c_str());
+    }
+
+    if (!checksum_file.empty()) {
+      std::ofstream ofs(checksum_file);
+      for (const auto & frame : frames_) {
+        ofs << frame.stamp_ns << " " << frame.num_objects << " " << std::hex << frame.checksum
+            << std::dec << "\n";
+      }
+    }
+  }
+
+private:
+  NodeParam node_param_;
+  tf2::BufferCore tf_buffer_{};
+  RadarObjectFusionCycle fusion_cycle_;
+  DetectedObjects output_objects_{};
+
+  std::vector<FrameResult> frames_{};
+  std::vector<double> latencies_ms_{};
+  std::size_t num_objects_{0};
+  std::size_t num_fused_{0};
+  std::size_t num_unmatched_{0};
+  // Matched but output without fusion, e.g. because of no transform
+  std::size_t num_not_fused_{0};
+  std::size_t num_skipped_sensors_{0};
+  std::size_t num_untransformed_sensors_{0};
+  std::string last_transform_error_{};
+  double wall_time_sec_{};
+
+  static RadarObjectFusionCycle::Param createCycleParam(
+    const NodeParam & node_param, const std::size_t num_radars)
+  {
+    RadarObjectFusionCycle::Param cycle_param{};
+    cycle_param.num_radars = num_radars;
+    cycle_param.radar_buffer_size = static_cast<std::size_t>(node_param.radar_buffer_size);
+    cycle_param.stamp_tolerance_sec = node_param.stamp_tolerance_sec;
+    cycle_param.is_object_trigger = node_param.trigger_mode == "object";
+    cycle_param.use_ego_odometry = node_param.use_ego_odometry;
+    return cycle_param;
+  }
+
+  void fuseIfReady(const int64_t now_ns, const bool force = false)
+  {
+    const auto & pairing = fusion_cycle_.getPairing();
+    if (!pairing.hasObjects() || !pairing.hasRadar()) {
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const auto pair_result = fusion_cycle_.pair(now_ns, force);
+    if (pair_result == Result::SKIPPED) {
+      return;
+    }
+    const auto & cycle_report = fusion_cycle_.fuse(output_objects_);
+    latencies_ms_.push_back(
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    frames_.push_back(FrameResult{
+      toNanoseconds(output_objects_.header.stamp), output_objects_.objects.size(),
+      calcChecksum(output_objects_)});
+
+    if (pair_result == Result::UNMATCHED) {
+      ++num_unmatched_;
+      return;
+    }
+    if (cycle_report.is_fused) {
+      ++num_fused_;
+    } else {
+      ++num_not_fused_;
+    }
+    num_skipped_sensors_ += cycle_report.num_skipped_sensors;
+    num_untransformed_sensors_ += cycle_report.num_untransformed_sensors;
+    if (cycle_report.num_untransformed_sensors > 0) {
+      last_transform_error_ = cycle_report.transform_error;
+    }
+  }
+};
+
+bool parseOption(const std::vector<std::string> & args, ReplayOption & option)
+{
+  for (std::size_t i = 1; i < args.size(); ++i) {
+    const auto & arg = args.at(i);
+    const bool has_value = i + 1 < args.size();
+    if (arg == "--objects-topic" && has_value) {
+      option.objects_topic = args.at(++i);
+    } else if (arg == "--radars-topic" && has_value) {
+      option.radars_topics.push_back(args.at(++i));
+    } else if (arg == "--odometry-topic" && has_value) {
+      option.odometry_topic = args.at(++i);
+    } else if (arg == "--checksum-file" && has_value) {
+      option.checksum_file = args.at(++i);
+    } else if (option.bag_uri.empty() && arg.rfind("--", 0) != 0) {
+      option.bag_uri = arg;
+    } else {
+      return false;
+    }
+  }
+  if (option.radars_topics.empty()) {
+    option.radars_topics.push_back("/sensing/radar/detected_objects");
+  }
+  return !option.bag_uri.empty();
+}
+}  // namespace
+}  // namespace radar_fusion_to_detected_object
+
+int main(int argc, char ** argv)
+{
+  using radar_fusion_to_detected_object::FusionReplay;
+  using radar_fusion_to_detected_object::RadarObjectFusionToDetectedObjectNode;
+
+  rclcpp::init(argc, argv);
+  radar_fusion_to_detected_object::ReplayOption option{};
+  if (!radar_fusion_to_detected_object::parseOption(
+        rclcpp::remove_ros_arguments(argc, argv), option)) {
+    std::fprintf(
+      stderr,
+      "Usage: %s <bag> [--objects-topic <topic>] [--radars-topic <topic> ...] "
+      "[--odometry-topic <topic>] [--checksum-file <path>] [--ros-args --params-file <yaml>]\n",
+      argv[0]);
+    rclcpp::shutdown();
+    return 1;
+  }
+
+  // Parameters are read in the same way as the node, but the node is not spun
+  auto node = std::make_shared<rclcpp::Node>("radar_object_fusion_replay");
+  FusionReplay::NodeParam node_param{};
+  radar_fusion_to_detected_object::RadarFusionToDetectedObject::Param core_param{};
+  RadarObjectFusionToDetectedObjectNode::declareParams(*node, node_param, core_param);
+
+  auto events = radar_fusion_to_detected_object::readBag(option);
+  std::printf("loaded %zu messages from %s\n", events.size(), option.bag_uri.c_str());
+
+  FusionReplay replay(node_param, core_param, option.radars_topics.size());
+  replay.run(events);
+  replay.report(option.checksum_file);
+
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SYNTHETIC_SCENE_HPP_
+#define SYNTHETIC_SCENE_HPP_
+
+#include "radar_fusion_to_detected_object.hpp"
+
+#include "autoware_auto_perception_msgs/msg/detected_objects.hpp"
+#include "geometry_msgs/msg/pose_with_covariance.hpp"
+#include "geometry_msgs/msg/twist_with_covariance.hpp"
+#include "std_msgs/msg/header.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+struct SceneParam
+{
+  unsigned int seed{0};
+  std::size_t num_objects{};
+  std::size_t num_radars{};
+  // Length of objects. The width is a half of the length. [m]
+  double object_length{4.5};
+  // Ratio of radar data placed inside of objects. The rest is scattered over the scene.
+  double cluster_ratio{0.5};
+  // Objects and radar data are placed in [-extent, extent] on x and y [m]
+  double extent{100.0};
+  // If true, radar data is a radar scan with only doppler velocity given as Input::radar_batch
+  bool use_radar_scan{false};
+};
+
+// Seeded synthetic input of RadarFusionToDetectedObject::update().
+// Radar inputs are views to the messages owned by the scene.
+struct SyntheticScene
+{
+  std_msgs::msg::Header radar_header{};
+  std::vector<geometry_msgs::msg::PoseWithCovariance> radar_poses{};
+  std::vector<geometry_msgs::msg::TwistWithCovariance> radar_twists{};
+  RadarFusionToDetectedObject::Input input{};
+  // Radar data packed in the same way as update()
+  RadarFusionToDetectedObject::RadarBatch radar_batch{};
+};
+
+inline void setYaw(const double yaw, geometry_msgs::msg::Quaternion & orientation)
+{
+  orientation.x = 0.0;
+  orientation.y = 0.0;
+  orientation.z = std::sin(yaw / 2.0);
+  orientation.w = std::cos(yaw / 2.0);
+}
+
+inline std::unique_ptr<SyntheticScene> generateSyntheticScene(const SceneParam & param)
+{
+  using autoware_auto_perception_msgs::msg::DetectedObject;
+  using autoware_auto_perception_msgs::msg::DetectedObjects;
+  using autoware_auto_perception_msgs::msg::ObjectClassification;
+
+  std::mt19937 rng(param.seed);
+  std::uniform_real_distribution<double> position_dist(-param.extent, param.extent);
+  std::uniform_real_distribution<double> yaw_dist(-M_PI, M_PI);
+  std::uniform_real_distribution<double> unit_dist(0.0, 1.0);
+  std::uniform_real_distribution<double> velocity_dist(-20.0, 20.0);
+
+  auto scene = std::make_unique<SyntheticScene>();
+  auto objects = std::make_shared<DetectedObjects>();
+  objects->header.frame_id = "base_link";
+  scene->radar_header.frame_id = "base_link";
+
+  objects->objects.reserve(param.num_objects);
+  for (std::size_t i = 0; i < param.num_objects; ++i) {
+    DetectedObject object{};
+    ObjectClassification classification{};
+    classification.label = ObjectClassification::CAR;
+    classification.probability = static_cast<float>(unit_dist(rng));
+    object.classification.push_back(classification);
+    auto & pose = object.kinematics.pose_with_covariance.pose;
+    pose.position.x = position_dist(rng);
+    pose.position.y = position_dist(rng);
+    setYaw(yaw_dist(rng), pose.orientation);
+    object.shape.dimensions.x = param.object_length;
+    object.shape.dimensions.y = param.object_length / 2.0;
+    objects->objects.push_back(object);
+  }
+
+  scene->radar_poses.resize(param.num_radars);
+  scene->radar_twists.resize(param.num_radars);
+  auto radars = std::make_shared<std::vector<RadarFusionToDetectedObject::RadarInput>>();
+  radars->reserve(param.num_radars);
+  for (std::size_t i = 0; i < param.num_radars; ++i) {
+    auto & position = scene->radar_poses.at(i).pose.position;
+    if (!objects->objects.empty() && unit_dist(rng) < param.cluster_ratio) {
+      const auto & object =
+        objects->objects.at(static_cast<std::size_t>(rng() % objects->objects.size()));
+      const auto & center = object.kinematics.pose_with_covariance.pose.position;
+      position.x = center.x + (unit_dist(rng) - 0.5) * object.shape.dimensions.y;
+      position.y = center.y + (unit_dist(rng) - 0.5) * object.shape.dimensions.y;
+    } else {
+      position.x = position_dist(rng);
+      position.y = position_dist(rng);
+    }
+    auto & linear = scene->radar_twists.at(i).twist.linear;
+    linear.x = velocity_dist(rng);
+    linear.y = velocity_dist(rng);
+
+    RadarFusionToDetectedObject::RadarInput radar{};
+    radar.header = &scene->radar_header;
+    radar.pose_with_covariance = &scene->radar_poses.at(i);
+    radar.twist_with_covariance = &scene->radar_twists.at(i);
+    radar.target_value = unit_dist(rng);
+    if (param.use_radar_scan) {
+      const double azimuth = std::atan2(position.y, position.x);
+      const double doppler = linear.x * std::cos(azimuth) + linear.y * std::sin(azimuth);
+      scene->radar_batch.push_back_polar(
+        std::hypot(position.x, position.y), azimuth, doppler, radar.target_value, i);
+    } else {
+      radars->push_back(radar);
+      scene->radar_batch.push_back(radar, i);
+    }
+  }
+
+  scene->input.objects = objects;
+  if (param.use_radar_scan) {
+    scene->input.radar_batch =
+      std::make_shared<const RadarFusionToDetectedObject::RadarBatch>(scene->radar_batch);
+  } else {
+    scene->input.radars = radars;
+  }
+  return scene;
+}
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // SYNTHETIC_SCENE_HPP_
@@ -15,8 +15,11 @@
 #ifndef RADAR_FUSION_TO_DETECTED_OBJECT_HPP_
 #define RADAR_FUSION_TO_DETECTED_OBJECT_HPP_
 
-#include "rclcpp/logger.hpp"
-#include "tier4_autoware_utils/tier4_autoware_utils.hpp"
+#include "radar_fusion_to_detected_object/cycle_arena.hpp"
+#include "radar_fusion_to_detected_object/point_in_box_kernel.hpp"
+#include "radar_fusion_to_detected_object/radar_grid_index.hpp"
+#include "radar_fusion_to_detected_object/thread_pool.hpp"
+#include "tier4_autoware_utils/math/normalization.hpp"
 
 #define EIGEN_MPL2_ONLY
 #include <Eigen/Core>
@@ -27,8 +30,12 @@
 #include "geometry_msgs/msg/twist_with_covariance.hpp"
 // #include "std_msgs/msg/header.hpp"
 
+#include <array>
 #include <memory>
+#include <memory_resource>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace radar_fusion_to_detected_object
@@ -39,13 +46,11 @@ using geometry_msgs::msg::Point;
 using geometry_msgs::msg::PoseWithCovariance;
 using geometry_msgs::msg::Twist;
 using geometry_msgs::msg::TwistWithCovariance;
-using tier4_autoware_utils::LinearRing2d;
-using tier4_autoware_utils::Point2d;
 
 class RadarFusionToDetectedObject
 {
 public:
-  explicit RadarFusionToDetectedObject(const rclcpp::Logger & logger) : logger_(logger) {}
+  RadarFusionToDetectedObject();
 
   struct Param
   {
@@ -54,6 +59,19 @@ public:
     double split_threshold_velocity{};
     double threshold_yaw_diff{};
 
+    // Spatial index param for linking radar data to objects
+    bool use_grid_index{};
+    double grid_cell_size{};
+
+    // Compensation param for the stamp difference between radar data and objects
+    bool compensate_radar_motion{};
+
+    // The number of threads to fuse objects in parallel. If 0, the number of CPU cores is used.
+    int num_threads{1};
+
+    // Radar data is packed in float for association and twist estimation if true
+    bool use_single_precision{};
+
     // Weight param for velocity estimation
     double velocity_weight_average{};
     double velocity_weight_median{};
@@ -61,55 +79,272 @@ public:
     double velocity_weight_target_value_average{};
     double velocity_weight_target_value_top{};
 
+    // Least squares param for velocity estimation from doppler velocity of all radar data.
+    // If the normal matrix is ill-conditioned, the weighted velocity above is used instead.
+    bool use_doppler_least_squares{};
+    // Minimum ratio of the smaller eigenvalue to the larger one of the normal matrix
+    double threshold_doppler_condition{};
+
     // Parameters for fixed object information
+    // Convert doppler velocity of radar data to twist along the heading of the object
     bool convert_doppler_to_twist{};
     float threshold_probability{};
   };
 
+  // Non-owning view of a radar point/object.
+  // The fields point into the received radar message, so that the message has to outlive update().
   struct RadarInput
   {
-    std_msgs::msg::Header header{};
-    PoseWithCovariance pose_with_covariance{};
-    TwistWithCovariance twist_with_covariance{};
+    const std_msgs::msg::Header * header{};
+    const PoseWithCovariance * pose_with_covariance{};
+    const TwistWithCovariance * twist_with_covariance{};
     double target_value{};
   };
 
+  // Structure-of-arrays radar data built once per cycle from Input::radars, or given as
+  // Input::radar_batch. The core algorithms only use position, velocity, line of sight and target
+  // value, so that they are packed into contiguous columns. Values are calculated in double and
+  // stored in the scalar type T, which is double or float.
+  template <typename T>
+  struct BasicRadarBatch
+  {
+    std::vector<T> x{};
+    std::vector<T> y{};
+    std::vector<T> vx{};
+    std::vector<T> vy{};
+    std::vector<T> vz{};
+    // Unit line of sight from the origin of the frame, which is the radar if the frame is radar
+    std::vector<T> los_x{};
+    std::vector<T> los_y{};
+    // Radial velocity along the line of sight [m/s]
+    std::vector<T> doppler{};
+    std::vector<T> target_value{};
+    // Index of the source radar data in Input::radars or the radar message of its sensor
+    std::vector<std::size_t> source_index{};
+
+    std::size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    void clear();
+    void reserve(const std::size_t size);
+    void push_back(const RadarInput & radar, const std::size_t index);
+    // Radar point measured in polar coordinates of the radar frame, whose velocity is only
+    // the doppler velocity
+    void push_back_polar(
+      const double range, const double azimuth, const double doppler, const double target_value,
+      const std::size_t index);
+    // Copy radar data of another scalar type
+    template <typename U>
+    void assign(const BasicRadarBatch<U> & other);
+    // Append radar data of another sensor
+    void append(const BasicRadarBatch & other);
+    // Rigid transform of radar data in [begin, end) on the xy-plane of its frame into another
+    // frame. Line of sight stays from the radar, so that doppler velocity is not changed.
+    void transform(
+      const Eigen::Isometry3d & transform, const std::size_t begin, const std::size_t end);
+  };
+  using RadarBatch = BasicRadarBatch<double>;
+
+  // Range of radar data measured by a sensor at the same stamp
+  struct RadarSegment
+  {
+    std::size_t begin{};
+    std::size_t end{};
+    // Time from the stamp of the sensor to the stamp of objects [s]
+    double time_offset{};
+  };
+
   struct Input
   {
+    // Views of radar data. The buffer can be reused over cycles to avoid allocation.
     std::shared_ptr<std::vector<RadarInput>> radars{};
+    // Radar data already packed by the caller, which is used instead of radars if given
+    std::shared_ptr<const RadarBatch> radar_batch{};
     DetectedObjects::ConstSharedPtr objects{};
+    // Time from the stamp of radar data to the stamp of objects [s]
+    double radar_time_offset{};
+    // Ranges of radar data merged from multiple sensors, which are used instead of
+    // radar_time_offset if given. The buffer can be reused over cycles to avoid allocation.
+    std::shared_ptr<std::vector<RadarSegment>> radar_segments{};
+    // Twist of ego vehicle used if objects are in the ego vehicle frame
+    std::shared_ptr<Twist> ego_twist{};
+  };
+
+  // Processing time of each stage in update() [ms]
+  // If objects are fused in parallel, the time of stages per object is the sum over threads.
+  struct ProcessingTime
+  {
+    double input_conversion_ms{};
+    double association_ms{};
+    double qualification_ms{};
+    double twist_estimation_ms{};
+    // Merge of qualified objects with their twists into the output
+    double output_ms{};
   };
 
   struct Output
   {
     DetectedObjects objects{};
+    ProcessingTime processing_time{};
   };
 
+  // Indices of RadarBatch allocated from the arena of the cycle
+  using RadarIndices = std::pmr::vector<std::size_t>;
+
   void setParam(const Param & param);
   Output update(const Input & input);
+  // Fuse objects owned by the caller in place without copying them into Output.
+  // Twists of qualified objects are set, and disqualified objects are removed keeping the order.
+  // input.objects is not used.
+  ProcessingTime update(const Input & input, DetectedObjects & objects);
+
+  // The number of allocations from the global allocator by intermediate containers in the last
+  // update(). This is 0 in the steady state.
+  std::size_t getArenaUpstreamAllocationCount() const;
+
+  // Threads of update(), which the caller can also use to prepare inputs before update()
+  ThreadPool & getThreadPool() { return *thread_pool_; }
+
+  // Stages of update(), which are also used for benchmarking.
+  // They use the buffers of the calling thread of update(). T is double or float.
+  template <typename T>
+  void filterRadarWithinObject(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars,
+    const RadarGridIndex * grid_index, RadarIndices & outputs);
+  template <typename T>
+  TwistWithCovariance estimateTwist(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars, const RadarIndices & indices);
 
 private:
-  rclcpp::Logger logger_;
+  template <typename T>
+  struct ConvertedTwist
+  {
+    std::vector<T> vx{};
+    std::vector<T> vy{};
+    std::vector<T> vz{};
+  };
+
+  // Buffers used by one thread in update(). Each thread has its own buffers, so that objects are
+  // fused in parallel without sharing mutable state.
+  struct WorkerContext
+  {
+    CycleArena arena{};
+    std::vector<std::size_t> grid_candidates{};
+    std::vector<std::pair<double, std::size_t>> median_scratch{};
+    // Twist converted from doppler velocity of each scalar type, indexed same as RadarBatch
+    std::tuple<ConvertedTwist<double>, ConvertedTwist<float>> converted_twists{};
+    ProcessingTime processing_time{};
+  };
+
+  // Velocity columns used for twist estimation, indexed same as RadarBatch
+  template <typename T>
+  struct VelocityColumns
+  {
+    const T * vx{};
+    const T * vy{};
+    const T * vz{};
+  };
+
+  template <typename T>
+  using Vector2 = Eigen::Matrix<T, 2, 1>;
+
+  // Bitmask of velocity estimation strategies whose weight is positive
+  enum WeightStrategy : unsigned int {
+    MIN_DISTANCE = 1U << 0,
+    MEDIAN = 1U << 1,
+    AVERAGE = 1U << 2,
+    TARGET_VALUE_TOP = 1U << 3,
+    TARGET_VALUE_AVERAGE = 1U << 4,
+  };
+  static constexpr std::size_t num_weight_strategy_masks = 1U << 5;
+
+  // Weighted twist estimation specialized for a bitmask of strategies
+  template <typename T>
+  using WeightedTwistEstimator = Vector2<T> (RadarFusionToDetectedObject::*)(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars,
+    const VelocityColumns<T> & velocity, const RadarIndices & indices, WorkerContext & context);
+
+  // Result of an input object, which is merged into the output in the order of input objects
+  struct ObjectResult
+  {
+    bool is_qualified{};
+    bool has_twist{};
+    TwistWithCovariance twist_with_covariance{};
+    std::size_t output_index{};
+  };
+
   Param param_{};
-  std::shared_ptr<std::vector<RadarInput>> filterRadarWithinObject(
-    const DetectedObject & object, const std::shared_ptr<std::vector<RadarInput>> & radars);
+  RadarBatch radar_batch_{};
+  BasicRadarBatch<float> radar_batch_f_{};
+  RadarGridIndex grid_index_{};
+  std::vector<ObjectResult> object_results_{};
+  std::unique_ptr<ThreadPool> thread_pool_{std::make_unique<ThreadPool>(1)};
+  std::vector<std::unique_ptr<WorkerContext>> worker_contexts_{};
+  // Selected from the table by the weight param in setParam()
+  WeightedTwistEstimator<double> estimate_weighted_twist_{
+    &RadarFusionToDetectedObject::estimateWeightedTwist<double, 0>};
+  WeightedTwistEstimator<float> estimate_weighted_twist_f_{
+    &RadarFusionToDetectedObject::estimateWeightedTwist<float, 0>};
+  std::size_t fuseObjects(
+    const Input & input, const std::vector<DetectedObject> & objects,
+    ProcessingTime & processing_time);
+  template <typename T>
+  std::size_t fuseObjects(
+    const Input & input, const std::vector<DetectedObject> & objects,
+    BasicRadarBatch<T> & radar_batch, ProcessingTime & processing_time);
+  template <typename T>
+  void fuseObject(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars,
+    const RadarGridIndex * grid_index, WorkerContext & context, ObjectResult & result);
+  void annotateObject(const ObjectResult & result, DetectedObject & object);
+  void accumulateProcessingTime(ProcessingTime & processing_time);
+  template <typename T>
+  void compensateRadarMotion(
+    BasicRadarBatch<T> & radars, const std::size_t begin, const std::size_t end,
+    const double time_offset, const std::shared_ptr<Twist> & ego_twist);
+  template <typename T>
+  void filterRadarWithinObject(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars,
+    const RadarGridIndex * grid_index, WorkerContext & context, RadarIndices & outputs);
+  template <typename T>
+  void filterRadarWithinObject(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars,
+    const RadarIndices & candidates, RadarIndices & outputs);
   // [TODO] (Satoshi Tanaka) Implement
   // std::vector<DetectedObject> splitObject(
-  //   const DetectedObject & object, const std::shared_ptr<std::vector<RadarInput>> & radars);
+  //   const DetectedObject & object, const RadarBatch & radars, const RadarIndices & indices);
+  template <typename T>
   TwistWithCovariance estimateTwist(
-    const DetectedObject & object, std::shared_ptr<std::vector<RadarInput>> & radars);
-  bool isQualified(
-    const DetectedObject & object, std::shared_ptr<std::vector<RadarInput>> & radars);
-  TwistWithCovariance convertDopplerToTwist(
-    const DetectedObject & object, const TwistWithCovariance & twist_with_covariance);
+    const DetectedObject & object, const BasicRadarBatch<T> & radars,
+    const RadarIndices & indices, WorkerContext & context);
+  template <typename T>
+  WeightedTwistEstimator<T> getWeightedTwistEstimator() const;
+  template <typename T, unsigned int Strategies>
+  Vector2<T> estimateWeightedTwist(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars,
+    const VelocityColumns<T> & velocity, const RadarIndices & indices, WorkerContext & context);
+  template <typename T, std::size_t... Masks>
+  static std::array<WeightedTwistEstimator<T>, sizeof...(Masks)> makeWeightedTwistEstimators(
+    std::index_sequence<Masks...>);
+  template <typename T>
+  bool estimateTwistByDopplerLeastSquares(
+    const BasicRadarBatch<T> & radars, const RadarIndices & indices, Vector2<T> & twist);
+  template <typename T>
+  Vector2<T> calcMedianTwist(
+    const VelocityColumns<T> & velocity, const RadarIndices & indices, WorkerContext & context);
+  bool isQualified(const DetectedObject & object, const RadarIndices & indices);
+  template <typename T>
+  void convertDopplerToTwist(
+    const DetectedObject & object, const BasicRadarBatch<T> & radars, const RadarIndices & indices,
+    WorkerContext & context, RadarIndices & converted_indices);
   bool isYawCorrect(
     const DetectedObject & object, const TwistWithCovariance & twist_with_covariance,
     const double & yaw_threshold);
-  Eigen::Vector2d toVector2d(const TwistWithCovariance & twist_with_covariance);
-  TwistWithCovariance toTwistWithCovariance(const Eigen::Vector2d & vector2d);
+  template <typename T>
+  Vector2<T> toVector2d(const VelocityColumns<T> & velocity, const std::size_t index);
+  template <typename T>
+  TwistWithCovariance toTwistWithCovariance(const Vector2<T> & vector2d);
 
-  double getTwistNorm(const Twist & twist);
-  LinearRing2d createObject2dWithMargin(const Point2d object_size, const double margin);
+  OrientedBox2d createObjectBox(const DetectedObject & object);
 };
 }  // namespace radar_fusion_to_detected_object
 
@@ -0,0 +1,65 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_FUSION_TO_DETECTED_OBJECT__CYCLE_ARENA_HPP_
+#define RADAR_FUSION_TO_DETECTED_OBJECT__CYCLE_ARENA_HPP_
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Monotonic arena for intermediate containers, which is reset at the start of each cycle.
+// If a cycle runs out of the buffer, the arena falls back to the global allocator and enlarges the
+// buffer at the next reset, so that the steady state does not call the global allocator.
+class CycleArena
+{
+public:
+  explicit CycleArena(const std::size_t initial_size = 64 * 1024);
+
+  CycleArena(const CycleArena &) = delete;
+  CycleArena & operator=(const CycleArena &) = delete;
+
+  // Release all memory allocated in the last cycle
+  void reset();
+
+  std::pmr::memory_resource * resource() { return &*resource_; }
+
+  // The number of allocations from the global allocator since the last reset
+  std::size_t getUpstreamAllocationCount() const { return upstream_.allocation_count; }
+
+  std::size_t getBufferSize() const { return buffer_.size(); }
+
+private:
+  class CountingResource : public std::pmr::memory_resource
+  {
+  public:
+    std::size_t allocation_count{0};
+    std::size_t allocated_bytes{0};
+
+  private:
+    void * do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override;
+  };
+
+  std::vector<std::byte> buffer_;
+  CountingResource upstream_{};
+  std::optional<std::pmr::monotonic_buffer_resource> resource_{};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_FUSION_TO_DETECTED_OBJECT__CYCLE_ARENA_HPP_
@@ -0,0 +1,80 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_FUSION_TO_DETECTED_OBJECT__POINT_IN_BOX_KERNEL_HPP_
+#define RADAR_FUSION_TO_DETECTED_OBJECT__POINT_IN_BOX_KERNEL_HPP_
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Oriented rectangle from bird's-eye view
+struct OrientedBox2d
+{
+  double center_x{};
+  double center_y{};
+  double cos_yaw{};
+  double sin_yaw{};
+  // Half size including margin
+  double half_length{};
+  double half_width{};
+};
+
+enum class PointInBoxKernel { SCALAR, AVX2, NEON };
+
+OrientedBox2d createOrientedBox2d(
+  const double center_x, const double center_y, const double yaw, const double length,
+  const double width, const double margin);
+
+// Half size of the axis-aligned bounding box of the oriented box
+void getEnvelopeHalfSize(const OrientedBox2d & box, double & half_size_x, double & half_size_y);
+
+// Append indices of points strictly inside of the box to indices.
+// Points are rotated into the box frame and compared with the half size, which is same as
+// boost::geometry::within for the rectangle. The SIMD kernel is selected at runtime.
+// Points of float are checked in float, so that a SIMD register holds twice the points of double.
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const double * xs, const double * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices);
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const float * xs, const float * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices);
+
+// Same as above, but only points of candidates are checked
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const double * xs, const double * ys, const std::size_t * candidates,
+  const std::size_t num_candidates, std::pmr::vector<std::size_t> & indices);
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const float * xs, const float * ys, const std::size_t * candidates,
+  const std::size_t num_candidates, std::pmr::vector<std::size_t> & indices);
+
+// Kernel selected for this CPU
+PointInBoxKernel getPointInBoxKernel();
+
+// True if the kernel is compiled in and supported by this CPU
+bool isPointInBoxKernelAvailable(const PointInBoxKernel kernel);
+
+// Same as above with the given kernel instead of the selected one for verification.
+// The kernel need to be available.
+void filterPointsWithinBox(
+  const PointInBoxKernel kernel, const OrientedBox2d & box, const double * xs, const double * ys,
+  const std::size_t size, std::pmr::vector<std::size_t> & indices);
+void filterPointsWithinBox(
+  const PointInBoxKernel kernel, const OrientedBox2d & box, const float * xs, const float * ys,
+  const std::size_t size, std::pmr::vector<std::size_t> & indices);
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_FUSION_TO_DETECTED_OBJECT__POINT_IN_BOX_KERNEL_HPP_
@@ -0,0 +1,166 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_FUSION_TO_DETECTED_OBJECT__RADAR_GRID_INDEX_HPP_
+#define RADAR_FUSION_TO_DETECTED_OBJECT__RADAR_GRID_INDEX_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Uniform grid over radar positions from bird's-eye view.
+// Radar points are bucketed once per cycle with a counting sort, and a query visits only the
+// cells overlapped by the query box instead of every radar point.
+class RadarGridIndex
+{
+public:
+  // Build the index. get_position(i, x, y) writes the position of the i-th radar point.
+  template <class GetPosition>
+  void build(const std::size_t size, GetPosition get_position, const double cell_size)
+  {
+    clear();
+    if (size == 0 || !(cell_size > 0.0)) {
+      return;
+    }
+
+    // Bounds of finite points
+    positions_x_.resize(size);
+    positions_y_.resize(size);
+    double min_x = std::numeric_limits<double>::max();
+    double min_y = std::numeric_limits<double>::max();
+    double max_x = std::numeric_limits<double>::lowest();
+    double max_y = std::numeric_limits<double>::lowest();
+    for (std::size_t i = 0; i < size; ++i) {
+      get_position(i, positions_x_[i], positions_y_[i]);
+      if (!std::isfinite(positions_x_[i]) || !std::isfinite(positions_y_[i])) {
+        continue;
+      }
+      min_x = std::min(min_x, positions_x_[i]);
+      min_y = std::min(min_y, positions_y_[i]);
+      max_x = std::max(max_x, positions_x_[i]);
+      max_y = std::max(max_y, positions_y_[i]);
+    }
+    if (max_x < min_x) {
+      return;
+    }
+
+    // Grow cells when the scene is sparse so that the number of cells stays O(n)
+    cell_size_ = cell_size;
+    const std::size_t max_num_cells = std::max<std::size_t>(16, 4 * size);
+    const double area_cells =
+      ((max_x - min_x) / cell_size_ + 1.0) * ((max_y - min_y) / cell_size_ + 1.0);
+    if (area_cells > static_cast<double>(max_num_cells)) {
+      cell_size_ *= std::sqrt(area_cells / static_cast<double>(max_num_cells));
+    }
+    min_x_ = min_x;
+    min_y_ = min_y;
+    num_x_ = static_cast<std::size_t>((max_x - min_x) / cell_size_) + 1;
+    num_y_ = static_cast<std::size_t>((max_y - min_y) / cell_size_) + 1;
+
+    // Counting sort of points by cell
+    cell_of_point_.assign(size, invalid_cell);
+    cell_start_.assign(num_x_ * num_y_ + 1, 0);
+    for (std::size_t i = 0; i < size; ++i) {
+      if (!std::isfinite(positions_x_[i]) || !std::isfinite(positions_y_[i])) {
+        continue;
+      }
+      const std::size_t cell = toCellX(positions_x_[i]) + toCellY(positions_y_[i]) * num_x_;
+      cell_of_point_[i] = cell;
+      ++cell_start_[cell + 1];
+    }
+    for (std::size_t cell = 0; cell < num_x_ * num_y_; ++cell) {
+      cell_start_[cell + 1] += cell_start_[cell];
+    }
+    point_indices_.resize(cell_start_.back());
+    cell_fill_.assign(cell_start_.begin(), cell_start_.end() - 1);
+    for (std::size_t i = 0; i < size; ++i) {
+      if (cell_of_point_[i] != invalid_cell) {
+        point_indices_[cell_fill_[cell_of_point_[i]]++] = i;
+      }
+    }
+  }
+
+  // Collect indices of radar points in the cells overlapped by the query box.
+  // The candidates are sorted in ascending order to keep the order of the input radar data.
+  void queryCandidates(
+    const double min_x, const double min_y, const double max_x, const double max_y,
+    std::vector<std::size_t> & candidates) const
+  {
+    candidates.clear();
+    if (empty() || !(min_x <= max_x) || !(min_y <= max_y) || max_x < min_x_ || max_y < min_y_) {
+      return;
+    }
+    const std::size_t begin_x = toCellX(min_x);
+    const std::size_t begin_y = toCellY(min_y);
+    const std::size_t end_x = toCellX(max_x);
+    const std::size_t end_y = toCellY(max_y);
+    for (std::size_t cell_y = begin_y; cell_y <= end_y; ++cell_y) {
+      for (std::size_t cell_x = begin_x; cell_x <= end_x; ++cell_x) {
+        const std::size_t cell = cell_x + cell_y * num_x_;
+        candidates.insert(
+          candidates.end(), point_indices_.begin() + cell_start_[cell],
+          point_indices_.begin() + cell_start_[cell + 1]);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+  }
+
+  bool empty() const { return num_x_ == 0 || num_y_ == 0; }
+
+  void clear()
+  {
+    num_x_ = 0;
+    num_y_ = 0;
+    point_indices_.clear();
+    cell_start_.clear();
+  }
+
+private:
+  static constexpr std::size_t invalid_cell = std::numeric_limits<std::size_t>::max();
+
+  double cell_size_{};
+  double min_x_{};
+  double min_y_{};
+  std::size_t num_x_{};
+  std::size_t num_y_{};
+
+  // Compressed cell storage: the points of a cell are point_indices_[cell_start_[c], ...[c + 1])
+  std::vector<std::size_t> cell_start_{};
+  std::vector<std::size_t> point_indices_{};
+
+  // Work buffers kept to avoid reallocation every cycle
+  std::vector<double> positions_x_{};
+  std::vector<double> positions_y_{};
+  std::vector<std::size_t> cell_of_point_{};
+  std::vector<std::size_t> cell_fill_{};
+
+  // Clamp to the grid, since a query box can be larger than the bounds of radar points
+  std::size_t toCellX(const double x) const
+  {
+    const double cell = std::floor((x - min_x_) / cell_size_);
+    return static_cast<std::size_t>(std::clamp(cell, 0.0, static_cast<double>(num_x_ - 1)));
+  }
+  std::size_t toCellY(const double y) const
+  {
+    const double cell = std::floor((y - min_y_) / cell_size_);
+    return static_cast<std::size_t>(std::clamp(cell, 0.0, static_cast<double>(num_y_ - 1)));
+  }
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_FUSION_TO_DETECTED_OBJECT__RADAR_GRID_INDEX_HPP_
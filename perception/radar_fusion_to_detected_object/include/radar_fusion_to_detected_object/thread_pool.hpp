@@ -0,0 +1,83 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_FUSION_TO_DETECTED_OBJECT__THREAD_POOL_HPP_
+#define RADAR_FUSION_TO_DETECTED_OBJECT__THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Fixed-size thread pool for data-parallel loops.
+// The calling thread also processes chunks, so that num_threads - 1 threads are created.
+class ThreadPool
+{
+public:
+  explicit ThreadPool(const std::size_t num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool & operator=(const ThreadPool &) = delete;
+
+  std::size_t getNumThreads() const { return workers_.size() + 1; }
+
+  // Call func(begin, end, thread_index) for chunks of [0, size) and wait until all chunks finish.
+  // Idle threads take the next chunk from a shared counter. thread_index is less than
+  // getNumThreads(), and 0 is the calling thread. An exception thrown by func is rethrown here.
+  template <class Func>
+  void parallelFor(const std::size_t size, const std::size_t chunk_size, Func && func)
+  {
+    using FuncT = std::remove_reference_t<Func>;
+    run(
+      size, chunk_size,
+      [](void * context, std::size_t begin, std::size_t end, std::size_t thread_index) {
+        (*static_cast<FuncT *>(context))(begin, end, thread_index);
+      },
+      const_cast<void *>(static_cast<const void *>(&func)));
+  }
+
+private:
+  using ChunkFunc = void (*)(void *, std::size_t, std::size_t, std::size_t);
+
+  std::vector<std::thread> workers_{};
+  std::mutex mutex_{};
+  std::condition_variable start_cv_{};
+  std::condition_variable done_cv_{};
+
+  // Task shared with workers, which is written under mutex_ before starting a generation
+  ChunkFunc func_{};
+  void * context_{};
+  std::size_t size_{0};
+  std::size_t chunk_size_{1};
+  std::atomic<std::size_t> next_begin_{0};
+  std::size_t generation_{0};
+  std::size_t num_running_workers_{0};
+  std::exception_ptr exception_{};
+  bool stop_{false};
+
+  void run(
+    const std::size_t size, const std::size_t chunk_size, ChunkFunc func, void * context);
+  void runChunks(const std::size_t thread_index);
+  void workerLoop(const std::size_t thread_index);
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_FUSION_TO_DETECTED_OBJECT__THREAD_POOL_HPP_
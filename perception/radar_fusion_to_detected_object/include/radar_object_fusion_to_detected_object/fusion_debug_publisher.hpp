@@ -0,0 +1,163 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__FUSION_DEBUG_PUBLISHER_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__FUSION_DEBUG_PUBLISHER_HPP_
+
+#include "diagnostic_updater/diagnostic_updater.hpp"
+#include "radar_fusion_to_detected_object.hpp"
+#include "radar_object_fusion_to_detected_object/sliding_window_statistics.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "tier4_autoware_utils/system/stop_watch.hpp"
+
+#include "tier4_debug_msgs/msg/float64_stamped.hpp"
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+
+namespace radar_fusion_to_detected_object
+{
+// Processing time of each stage and input age of the fusion nodes on ~/debug/ and /diagnostics.
+// This is shared by the nodes, so that they are monitored in the same way.
+class FusionDebugPublisher
+{
+public:
+  explicit FusionDebugPublisher(rclcpp::Node & node)
+  : clock_(node.get_clock()), diagnostic_updater_(&node)
+  {
+    // Publishers are created up front, and values are published only if subscribed
+    for (std::size_t i = 0; i < NUM_ITEMS; ++i) {
+      publishers_.at(i) = node.create_publisher<tier4_debug_msgs::msg::Float64Stamped>(
+        std::string("~/debug/") + item_names.at(i), 1);
+    }
+    diagnostic_updater_.setHardwareID("radar_fusion_to_detected_object");
+    diagnostic_updater_.add(
+      "processing_time", this, &FusionDebugPublisher::checkProcessingTime);
+  }
+  FusionDebugPublisher(const FusionDebugPublisher &) = delete;
+  FusionDebugPublisher & operator=(const FusionDebugPublisher &) = delete;
+
+  // The total processing time need to be within the update period in the timer mode.
+  // std::nullopt if fusion is triggered by detected objects.
+  void setUpdatePeriod(const std::optional<double> & update_period_ms)
+  {
+    update_period_ms_ = update_period_ms;
+  }
+
+  // Called at the start of a cycle and right before publishing detected objects
+  void startCycle() { stop_watch_.tic("total"); }
+  void startPublish() { stop_watch_.tic("publish"); }
+
+  // Called right after publishing detected objects.
+  // Processing time of fusion stages is given only if detected objects were fused with radar data,
+  // and the radar stamp is of the oldest sensor fused.
+  void endCycle(
+    const RadarFusionToDetectedObject::ProcessingTime * processing_time,
+    const rclcpp::Time & objects_stamp, const std::optional<rclcpp::Time> & radar_stamp)
+  {
+    const double publish_ms = stop_watch_.toc("publish");
+    const rclcpp::Time stamp = clock_->now();
+    if (processing_time) {
+      publish(INPUT_CONVERSION, processing_time->input_conversion_ms, stamp);
+      publish(ASSOCIATION, processing_time->association_ms, stamp);
+      publish(QUALIFICATION, processing_time->qualification_ms, stamp);
+      publish(TWIST_ESTIMATION, processing_time->twist_estimation_ms, stamp);
+      publish(OUTPUT, processing_time->output_ms, stamp);
+    }
+    publish(PUBLISH, publish_ms, stamp);
+    publish(TOTAL, stop_watch_.toc("total"), stamp);
+
+    // Age of inputs at publish
+    publish(OBJECTS_AGE, (stamp - objects_stamp).seconds() * 1e3, stamp);
+    if (radar_stamp) {
+      publish(RADAR_AGE, (stamp - *radar_stamp).seconds() * 1e3, stamp);
+    }
+  }
+
+private:
+  enum Item : std::size_t {
+    INPUT_CONVERSION = 0,
+    ASSOCIATION,
+    QUALIFICATION,
+    TWIST_ESTIMATION,
+    OUTPUT,
+    PUBLISH,
+    TOTAL,
+    OBJECTS_AGE,
+    RADAR_AGE,
+    NUM_ITEMS,
+  };
+  // Topic names under ~/debug/ and diagnostic keys in the order of Item
+  static constexpr std::array<const char *, NUM_ITEMS> item_names = {
+    "processing_time/input_conversion_ms",
+    "processing_time/association_ms",
+    "processing_time/qualification_ms",
+    "processing_time/twist_estimation_ms",
+    "processing_time/output_ms",
+    "processing_time/publish_ms",
+    "processing_time/total_ms",
+    "input_age/objects_ms",
+    "input_age/radar_ms",
+  };
+
+  rclcpp::Clock::SharedPtr clock_;
+  std::array<rclcpp::Publisher<tier4_debug_msgs::msg::Float64Stamped>::SharedPtr, NUM_ITEMS>
+    publishers_{};
+  std::array<SlidingWindowStatistics, NUM_ITEMS> statistics_{};
+  tier4_autoware_utils::StopWatch<std::chrono::milliseconds> stop_watch_{};
+  diagnostic_updater::Updater diagnostic_updater_;
+  std::optional<double> update_period_ms_{};
+
+  void publish(const Item item, const double value, const rclcpp::Time & stamp)
+  {
+    statistics_.at(item).add(value);
+
+    const auto & publisher = publishers_.at(item);
+    if (
+      publisher->get_subscription_count() + publisher->get_intra_process_subscription_count() ==
+      0) {
+      return;
+    }
+    tier4_debug_msgs::msg::Float64Stamped msg{};
+    msg.stamp = stamp;
+    msg.data = value;
+    publisher->publish(msg);
+  }
+
+  void checkProcessingTime(diagnostic_updater::DiagnosticStatusWrapper & stat)
+  {
+    for (std::size_t i = 0; i < NUM_ITEMS; ++i) {
+      const auto summary = statistics_.at(i).summarize();
+      const std::string name = item_names.at(i);
+      stat.add(name + "_p50", summary.p50);
+      stat.add(name + "_p99", summary.p99);
+      stat.add(name + "_max", summary.max);
+    }
+
+    const auto total = statistics_.at(TOTAL).summarize();
+    if (total.count == 0) {
+      stat.summary(diagnostic_msgs::msg::DiagnosticStatus::OK, "No objects were published");
+    } else if (update_period_ms_ && *update_period_ms_ < total.p99) {
+      stat.summary(
+        diagnostic_msgs::msg::DiagnosticStatus::WARN, "Processing time exceeds the update period");
+    } else {
+      stat.summary(diagnostic_msgs::msg::DiagnosticStatus::OK, "OK");
+    }
+  }
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__FUSION_DEBUG_PUBLISHER_HPP_
@@ -0,0 +1,165 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__FUSION_NODE_PARAM_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__FUSION_NODE_PARAM_HPP_
+
+#include "radar_fusion_to_detected_object.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Parameters shared by the fusion nodes
+struct FusionNodeParam
+{
+  double update_rate_hz{};
+  // "timer": fuse at update_rate_hz, "object": fuse when detected objects arrive
+  std::string trigger_mode{};
+  // Radar data is paired with detected objects by the nearest stamp within tolerance
+  int radar_buffer_size{};
+  double stamp_tolerance_sec{};
+  // Use ego odometry to compensate the ego motion between radar data and detected objects
+  bool use_ego_odometry{};
+  // Publish fused objects in a message loaned from the middleware if it is supported
+  bool use_loaned_message{};
+};
+
+namespace fusion_node_param
+{
+template <class T>
+bool update_param(
+  const std::vector<rclcpp::Parameter> & params, const std::string & name, T & value)
+{
+  const auto itr = std::find_if(
+    params.cbegin(), params.cend(),
+    [&name](const rclcpp::Parameter & p) { return p.get_name() == name; });
+
+  // Not found
+  if (itr == params.cend()) {
+    return false;
+  }
+
+  value = itr->template get_value<T>();
+  return true;
+}
+}  // namespace fusion_node_param
+
+// Declare parameters of the fusion nodes with their defaults.
+// They are same for radar objects and radar scans, and the parameter files set the differences.
+// Throw std::invalid_argument if radar_buffer_size is less than 1.
+inline void declareFusionParams(
+  rclcpp::Node & node, FusionNodeParam & node_param,
+  RadarFusionToDetectedObject::Param & core_param)
+{
+  // Node Parameter
+  node_param.update_rate_hz = node.declare_parameter<double>("node_params.update_rate_hz", 10.0);
+  node_param.trigger_mode =
+    node.declare_parameter<std::string>("node_params.trigger_mode", "timer");
+  if (node_param.trigger_mode != "timer" && node_param.trigger_mode != "object") {
+    RCLCPP_ERROR(
+      node.get_logger(), "Unknown trigger_mode: %s. Use timer instead.",
+      node_param.trigger_mode.c_str());
+    node_param.trigger_mode = "timer";
+  }
+  node_param.radar_buffer_size = node.declare_parameter<int>("node_params.radar_buffer_size", 10);
+  if (node_param.radar_buffer_size < 1) {
+    throw std::invalid_argument(
+      "radar_buffer_size must be at least 1: " + std::to_string(node_param.radar_buffer_size));
+  }
+  node_param.stamp_tolerance_sec =
+    node.declare_parameter<double>("node_params.stamp_tolerance_sec", 0.1);
+  node_param.use_ego_odometry = node.declare_parameter<bool>("node_params.use_ego_odometry", false);
+  node_param.use_loaned_message =
+    node.declare_parameter<bool>("node_params.use_loaned_message", false);
+
+  // Core Parameter
+  core_param.bounding_box_margin =
+    node.declare_parameter<double>("core_params.bounding_box_margin", 0.5);
+  core_param.split_threshold_velocity =
+    node.declare_parameter<double>("core_params.split_threshold_velocity", 0.0);
+  core_param.threshold_yaw_diff =
+    node.declare_parameter<double>("core_params.threshold_yaw_diff", 0.35);
+  core_param.use_grid_index = node.declare_parameter<bool>("core_params.use_grid_index", false);
+  core_param.grid_cell_size = node.declare_parameter<double>("core_params.grid_cell_size", 4.0);
+  core_param.compensate_radar_motion =
+    node.declare_parameter<bool>("core_params.compensate_radar_motion", false);
+  core_param.num_threads = node.declare_parameter<int>("core_params.num_threads", 1);
+  core_param.use_single_precision =
+    node.declare_parameter<bool>("core_params.use_single_precision", false);
+  core_param.velocity_weight_min_distance =
+    node.declare_parameter<double>("core_params.velocity_weight_min_distance", 1.0);
+  core_param.velocity_weight_average =
+    node.declare_parameter<double>("core_params.velocity_weight_average", 0.0);
+  core_param.velocity_weight_median =
+    node.declare_parameter<double>("core_params.velocity_weight_median", 0.0);
+  core_param.velocity_weight_target_value_average =
+    node.declare_parameter<double>("core_params.velocity_weight_target_value_average", 0.0);
+  core_param.velocity_weight_target_value_top =
+    node.declare_parameter<double>("core_params.velocity_weight_target_value_top", 1.0);
+  core_param.use_doppler_least_squares =
+    node.declare_parameter<bool>("core_params.use_doppler_least_squares", false);
+  core_param.threshold_doppler_condition =
+    node.declare_parameter<double>("core_params.threshold_doppler_condition", 0.01);
+  core_param.convert_doppler_to_twist =
+    node.declare_parameter<bool>("core_params.convert_doppler_to_twist", false);
+  core_param.threshold_probability =
+    node.declare_parameter<float>("core_params.threshold_probability", 0.0);
+}
+
+// Update parameters changed at runtime. Parameters not in params are not changed.
+// Throw rclcpp::exceptions::InvalidParameterTypeException if a type is wrong.
+inline void updateFusionParams(
+  const std::vector<rclcpp::Parameter> & params, FusionNodeParam & node_param,
+  RadarFusionToDetectedObject::Param & core_param)
+{
+  using fusion_node_param::update_param;
+
+  // Node Parameter
+  {
+    auto & p = node_param;
+    update_param(params, "node_params.update_rate_hz", p.update_rate_hz);
+  }
+
+  // Core Parameter
+  {
+    auto & p = core_param;
+    update_param(params, "core_params.bounding_box_margin", p.bounding_box_margin);
+    update_param(params, "core_params.split_threshold_velocity", p.split_threshold_velocity);
+    update_param(params, "core_params.threshold_yaw_diff", p.threshold_yaw_diff);
+    update_param(params, "core_params.use_grid_index", p.use_grid_index);
+    update_param(params, "core_params.grid_cell_size", p.grid_cell_size);
+    update_param(params, "core_params.compensate_radar_motion", p.compensate_radar_motion);
+    update_param(params, "core_params.num_threads", p.num_threads);
+    update_param(params, "core_params.use_single_precision", p.use_single_precision);
+    update_param(params, "core_params.velocity_weight_average", p.velocity_weight_average);
+    update_param(params, "core_params.velocity_weight_median", p.velocity_weight_median);
+    update_param(
+      params, "core_params.velocity_weight_target_value_average",
+      p.velocity_weight_target_value_average);
+    update_param(
+      params, "core_params.velocity_weight_target_value_top", p.velocity_weight_target_value_top);
+    update_param(params, "core_params.use_doppler_least_squares", p.use_doppler_least_squares);
+    update_param(
+      params, "core_params.threshold_doppler_condition", p.threshold_doppler_condition);
+    update_param(params, "core_params.convert_doppler_to_twist", p.convert_doppler_to_twist);
+  }
+}
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__FUSION_NODE_PARAM_HPP_
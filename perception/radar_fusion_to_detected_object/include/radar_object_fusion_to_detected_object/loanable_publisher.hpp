@@ -0,0 +1,82 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__LOANABLE_PUBLISHER_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__LOANABLE_PUBLISHER_HPP_
+
+#include "rclcpp/rclcpp.hpp"
+
+#include <memory>
+#include <utility>
+
+namespace radar_fusion_to_detected_object
+{
+// Publisher whose message is written in place before publishing.
+// If enabled and the middleware supports it, the message is loaned from the middleware, e.g. shared
+// memory, so that a subscriber in another process receives it without copy. Otherwise, the message
+// is owned and published as unique_ptr, which is not copied within a process.
+// Middlewares loan only messages of fixed size, so that messages with unbounded sequences, e.g.
+// DetectedObjects, are never loaned.
+template <class MsgT>
+class LoanablePublisher
+{
+public:
+  using PublisherT = rclcpp::Publisher<MsgT>;
+
+  LoanablePublisher() = default;
+  LoanablePublisher(const typename PublisherT::SharedPtr & publisher, const bool use_loaned_message)
+  : publisher_(publisher), use_loaned_message_(use_loaned_message)
+  {
+  }
+
+  // Message to be written for the next publish(). The same message is returned until published.
+  MsgT & borrow()
+  {
+    if (loaned_message_) {
+      return loaned_message_->get();
+    }
+    if (owned_message_) {
+      return *owned_message_;
+    }
+    if (isLoanable()) {
+      loaned_message_ =
+        std::make_unique<rclcpp::LoanedMessage<MsgT>>(publisher_->borrow_loaned_message());
+      return loaned_message_->get();
+    }
+    owned_message_ = std::make_unique<MsgT>();
+    return *owned_message_;
+  }
+
+  // Publish the borrowed message. The message is not valid after this.
+  void publish()
+  {
+    if (loaned_message_) {
+      publisher_->publish(std::move(*loaned_message_));
+      loaned_message_.reset();
+    } else if (owned_message_) {
+      publisher_->publish(std::move(owned_message_));
+    }
+  }
+
+  bool isLoanable() const { return use_loaned_message_ && publisher_->can_loan_messages(); }
+
+private:
+  typename PublisherT::SharedPtr publisher_{};
+  bool use_loaned_message_{false};
+  std::unique_ptr<rclcpp::LoanedMessage<MsgT>> loaned_message_{};
+  std::unique_ptr<MsgT> owned_message_{};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__LOANABLE_PUBLISHER_HPP_
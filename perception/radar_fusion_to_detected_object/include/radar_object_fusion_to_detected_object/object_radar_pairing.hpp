@@ -0,0 +1,140 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__OBJECT_RADAR_PAIRING_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__OBJECT_RADAR_PAIRING_HPP_
+
+#include "radar_object_fusion_to_detected_object/stamped_ring_buffer.hpp"
+
+#include "autoware_auto_perception_msgs/msg/detected_objects.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Pairing of detected objects with buffered radar messages by the nearest stamp.
+// This is shared by the nodes and the offline replay, so that they fuse the same pairs.
+// Radar messages of multiple sensors are buffered separately, and each sensor is paired
+// independently, so that a sensor without recent data does not block the others.
+// Each detected objects are paired only once, so that they are published once.
+template <class RadarMsgT>
+class ObjectRadarPairing
+{
+public:
+  using DetectedObjects = autoware_auto_perception_msgs::msg::DetectedObjects;
+  using RadarConstSharedPtr = typename RadarMsgT::ConstSharedPtr;
+
+  enum class Result {
+    // No detected objects are pending, or they wait for radar messages nearer to them
+    SKIPPED = 0,
+    // No radar message of any sensor is within the stamp tolerance
+    UNMATCHED,
+    MATCHED,
+  };
+
+  ObjectRadarPairing(
+    const std::size_t radar_buffer_size, const double stamp_tolerance_sec,
+    const bool is_object_trigger, const std::size_t num_radars = 1)
+  : radar_buffers_(
+      std::max<std::size_t>(num_radars, 1), StampedRingBuffer<RadarMsgT>(radar_buffer_size)),
+    tolerance_ns_(static_cast<int64_t>(stamp_tolerance_sec * 1e9)),
+    is_object_trigger_(is_object_trigger),
+    radars_(radar_buffers_.size())
+  {
+  }
+
+  // Detected objects are owned so that they can be fused in place
+  void setObjects(DetectedObjects::SharedPtr objects)
+  {
+    objects_ = std::move(objects);
+    is_objects_taken_ = false;
+  }
+  void pushRadar(const RadarConstSharedPtr & radar, const std::size_t radar_index = 0)
+  {
+    radar_buffers_.at(radar_index).push(radar);
+  }
+
+  bool hasObjects() const { return static_cast<bool>(objects_); }
+  // True if detected objects are set and not taken yet
+  bool hasPendingObjects() const { return objects_ && !is_objects_taken_; }
+  // True if any sensor has radar data
+  bool hasRadar() const
+  {
+    return std::any_of(
+      radar_buffers_.begin(), radar_buffers_.end(),
+      [](const auto & radar_buffer) { return !radar_buffer.empty(); });
+  }
+
+  // Pair the pending detected objects with the radar message of the nearest stamp of each sensor.
+  // Unless they trigger fusion, they wait until every sensor has a radar message not older than
+  // them, because radar messages received later are not nearer, or until the stamp tolerance has
+  // passed at now_ns. If force, they are paired without waiting, e.g. before they are replaced.
+  Result pair(const int64_t now_ns, const bool force = false)
+  {
+    if (!hasPendingObjects()) {
+      return Result::SKIPPED;
+    }
+
+    const int64_t objects_stamp_ns = toNanoseconds(objects_->header.stamp);
+    bool is_matched = false;
+    bool is_complete = true;
+    for (std::size_t i = 0; i < radar_buffers_.size(); ++i) {
+      radars_[i] = radar_buffers_[i].findNearest(objects_stamp_ns, tolerance_ns_);
+      is_matched = is_matched || radars_[i];
+      const auto & latest_radar = radar_buffers_[i].latest();
+      is_complete = is_complete && latest_radar &&
+                    objects_stamp_ns <= toNanoseconds(latest_radar->header.stamp);
+    }
+
+    const bool is_expired = objects_stamp_ns + tolerance_ns_ <= now_ns;
+    if (!is_object_trigger_ && !force && !is_complete && !is_expired) {
+      return Result::SKIPPED;
+    }
+    return is_matched ? Result::MATCHED : Result::UNMATCHED;
+  }
+
+  // Detected objects of the last pair, which are valid until taken
+  const DetectedObjects & getObjects() const { return *objects_; }
+  // Radar message of a sensor in the last pair, which is nullptr if unmatched
+  const RadarConstSharedPtr & getRadar(const std::size_t radar_index = 0) const
+  {
+    return radars_.at(radar_index);
+  }
+  std::size_t getNumRadars() const { return radars_.size(); }
+
+  // Move detected objects of the last pair into the output message to fuse them in place.
+  // They are not paired again.
+  void takeObjects(DetectedObjects & output)
+  {
+    output = std::move(*objects_);
+    is_objects_taken_ = true;
+  }
+
+private:
+  std::vector<StampedRingBuffer<RadarMsgT>> radar_buffers_;
+  int64_t tolerance_ns_{};
+  bool is_object_trigger_{};
+
+  DetectedObjects::SharedPtr objects_{};
+  // True if the content of objects_ was moved out
+  bool is_objects_taken_{false};
+  std::vector<RadarConstSharedPtr> radars_{};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__OBJECT_RADAR_PAIRING_HPP_
@@ -0,0 +1,252 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_FUSION_CYCLE_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_FUSION_CYCLE_HPP_
+
+#include "radar_fusion_to_detected_object.hpp"
+#include "radar_object_fusion_to_detected_object/object_radar_pairing.hpp"
+#include "radar_object_fusion_to_detected_object/radar_transform_cache.hpp"
+
+#include "autoware_auto_perception_msgs/msg/detected_objects.hpp"
+#include "geometry_msgs/msg/twist.hpp"
+#include "nav_msgs/msg/odometry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Pairing, conversion and fusion of detected objects with radar messages of multiple sensors.
+// This depends neither on rclcpp nor on the executor, so that the nodes and the offline replay
+// fuse in the same way. The caller receives inputs and publishes output.
+// Only the conversion of a radar message into radar data depends on RadarMsgT, which is given as
+// ConvertFunc, so that radar objects and radar scans share the rest of the cycle.
+template <class RadarMsgT>
+class RadarFusionCycle
+{
+public:
+  using DetectedObjects = autoware_auto_perception_msgs::msg::DetectedObjects;
+  using Odometry = nav_msgs::msg::Odometry;
+  using Pairing = ObjectRadarPairing<RadarMsgT>;
+  using RadarConstSharedPtr = typename RadarMsgT::ConstSharedPtr;
+  // Pack a radar message into radar data in its frame. Return false if the message is invalid.
+  // This is called in parallel for different sensors.
+  using ConvertFunc =
+    std::function<bool(const RadarMsgT &, RadarFusionToDetectedObject::RadarBatch &)>;
+
+  struct Param
+  {
+    std::size_t num_radars{1};
+    // Radar messages are paired with detected objects by the nearest stamp within tolerance
+    std::size_t radar_buffer_size{1};
+    double stamp_tolerance_sec{};
+    // Pair detected objects as soon as they arrive without waiting for radar messages
+    bool is_object_trigger{};
+    // Use ego odometry to compensate the ego motion between radar data and detected objects
+    bool use_ego_odometry{};
+  };
+
+  // Summary of a fused cycle for logging and statistics
+  struct Report
+  {
+    // False if detected objects are output without fusion
+    bool is_fused{false};
+    RadarFusionToDetectedObject::ProcessingTime processing_time{};
+    // The number of sensors whose radar messages are not fused
+    std::size_t num_skipped_sensors{0};
+    // The number of sensors skipped because of no transform, whose reason is in transform_error
+    std::size_t num_untransformed_sensors{0};
+    std::string transform_error{};
+    // True if ego motion is not compensated because of no odometry in the frame of objects
+    bool is_odometry_missing{false};
+  };
+
+  RadarFusionCycle(const Param & param, const tf2::BufferCore & tf_buffer, ConvertFunc convert)
+  : param_(param),
+    pairing_(
+      param.radar_buffer_size, param.stamp_tolerance_sec, param.is_object_trigger,
+      param.num_radars),
+    transform_cache_(tf_buffer),
+    convert_(std::move(convert)),
+    radar_sensors_(std::max<std::size_t>(param.num_radars, 1))
+  {
+  }
+
+  void setCoreParam(const RadarFusionToDetectedObject::Param & core_param)
+  {
+    fusion_.setParam(core_param);
+  }
+
+  // Inputs
+  void setObjects(DetectedObjects::SharedPtr objects) { pairing_.setObjects(std::move(objects)); }
+  void pushRadar(const RadarConstSharedPtr & radar, const std::size_t index = 0)
+  {
+    pairing_.pushRadar(radar, index);
+  }
+  void setOdometry(const Odometry::ConstSharedPtr & odometry) { odometry_ = odometry; }
+  // Called when static transforms are updated
+  void clearTransformCache() { transform_cache_.clear(); }
+
+  // Pair the pending detected objects at now_ns. See ObjectRadarPairing::pair().
+  typename Pairing::Result pair(const int64_t now_ns, const bool force = false)
+  {
+    return pairing_.pair(now_ns, force);
+  }
+  // Move the paired detected objects into output and fuse them with the paired radar messages.
+  // This is called once after pair() returned other than SKIPPED.
+  const Report & fuse(DetectedObjects & output);
+
+  const Pairing & getPairing() const { return pairing_; }
+
+private:
+  struct RadarSensor
+  {
+    // Transform of the last pair from the radar frame to the frame of detected objects
+    std::optional<Eigen::Isometry3d> transform{};
+    bool is_same_frame{false};
+    // Radar data of the last pair in the frame of detected objects, which is reused over cycles
+    RadarFusionToDetectedObject::RadarBatch radar_batch{};
+    bool is_converted{false};
+  };
+
+  Param param_;
+  Pairing pairing_;
+  RadarTransformCache transform_cache_;
+  ConvertFunc convert_;
+  Odometry::ConstSharedPtr odometry_{};
+  std::vector<RadarSensor> radar_sensors_{};
+  Report report_{};
+
+  // Radar data merged from all sensors, which is reused over cycles
+  std::shared_ptr<RadarFusionToDetectedObject::RadarBatch> radar_batch_{
+    std::make_shared<RadarFusionToDetectedObject::RadarBatch>()};
+  std::shared_ptr<std::vector<RadarFusionToDetectedObject::RadarSegment>> radar_segments_{
+    std::make_shared<std::vector<RadarFusionToDetectedObject::RadarSegment>>()};
+  // Ego twist of the last odometry, which is assigned every cycle without allocation
+  std::shared_ptr<geometry_msgs::msg::Twist> ego_twist_{
+    std::make_shared<geometry_msgs::msg::Twist>()};
+  RadarFusionToDetectedObject fusion_{};
+};
+
+template <class RadarMsgT>
+const typename RadarFusionCycle<RadarMsgT>::Report & RadarFusionCycle<RadarMsgT>::fuse(
+  DetectedObjects & output)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const auto & detected_objects = pairing_.getObjects();
+  report_.is_fused = false;
+  report_.processing_time = RadarFusionToDetectedObject::ProcessingTime{};
+  report_.num_skipped_sensors = 0;
+  report_.num_untransformed_sensors = 0;
+  report_.is_odometry_missing = false;
+
+  // Set input data
+  // Sensors without radar messages within tolerance, without transform or with invalid messages
+  // are skipped, so that dropouts of some sensors do not stop fusion with the others
+  for (std::size_t i = 0; i < radar_sensors_.size(); ++i) {
+    auto & radar_sensor = radar_sensors_.at(i);
+    const auto & radar = pairing_.getRadar(i);
+    radar_sensor.is_converted = false;
+    if (radar) {
+      const auto & radar_frame = radar->header.frame_id;
+      const auto & objects_frame = detected_objects.header.frame_id;
+      radar_sensor.transform =
+        transform_cache_.getTransform(radar_frame, objects_frame, report_.transform_error);
+      radar_sensor.is_same_frame = radar_frame == objects_frame;
+      radar_sensor.is_converted = radar_sensor.transform.has_value();
+      if (!radar_sensor.is_converted) {
+        ++report_.num_untransformed_sensors;
+      }
+    }
+  }
+
+  // Radar messages of each sensor are converted into the frame of detected objects in parallel
+  fusion_.getThreadPool().parallelFor(
+    radar_sensors_.size(), 1,
+    [this](const std::size_t begin, const std::size_t end, const std::size_t /*thread_index*/) {
+      for (std::size_t i = begin; i < end; ++i) {
+        auto & radar_sensor = radar_sensors_.at(i);
+        if (!radar_sensor.is_converted) {
+          continue;
+        }
+        radar_sensor.is_converted = convert_(*pairing_.getRadar(i), radar_sensor.radar_batch);
+        if (radar_sensor.is_converted && !radar_sensor.is_same_frame) {
+          radar_sensor.radar_batch.transform(
+            *radar_sensor.transform, 0, radar_sensor.radar_batch.size());
+        }
+      }
+    });
+
+  // Merge radar data of all sensors with the time offset of each sensor.
+  // The batch is reused over cycles.
+  radar_batch_->clear();
+  radar_segments_->clear();
+  const int64_t objects_stamp_ns = toNanoseconds(detected_objects.header.stamp);
+  for (std::size_t i = 0; i < radar_sensors_.size(); ++i) {
+    const auto & radar_sensor = radar_sensors_.at(i);
+    if (!radar_sensor.is_converted) {
+      ++report_.num_skipped_sensors;
+      continue;
+    }
+    RadarFusionToDetectedObject::RadarSegment segment{};
+    segment.begin = radar_batch_->size();
+    radar_batch_->append(radar_sensor.radar_batch);
+    segment.end = radar_batch_->size();
+    segment.time_offset =
+      static_cast<double>(objects_stamp_ns - toNanoseconds(pairing_.getRadar(i)->header.stamp)) *
+      1e-9;
+    radar_segments_->push_back(segment);
+  }
+
+  // If no radar data is converted, output detected objects without fusion
+  if (radar_batch_->empty()) {
+    pairing_.takeObjects(output);
+    return report_;
+  }
+
+  RadarFusionToDetectedObject::Input input{};
+  input.radar_batch = radar_batch_;
+  input.radar_segments = radar_segments_;
+  if (param_.use_ego_odometry) {
+    if (odometry_ && odometry_->child_frame_id == detected_objects.header.frame_id) {
+      *ego_twist_ = odometry_->twist.twist;
+      input.ego_twist = ego_twist_;
+    } else {
+      report_.is_odometry_missing = true;
+    }
+  }
+
+  // Detected objects are not valid after taken
+  pairing_.takeObjects(output);
+  const double input_conversion_ms =
+    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  // Update
+  report_.processing_time = fusion_.update(input, output);
+  report_.processing_time.input_conversion_ms += input_conversion_ms;
+  report_.is_fused = true;
+  return report_;
+}
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_FUSION_CYCLE_HPP_
@@ -0,0 +1,48 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_OBJECT_FUSION_CYCLE_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_OBJECT_FUSION_CYCLE_HPP_
+
+#include "radar_fusion_to_detected_object.hpp"
+#include "radar_object_fusion_to_detected_object/radar_fusion_cycle.hpp"
+
+#include "autoware_auto_perception_msgs/msg/tracked_objects.hpp"
+
+namespace radar_fusion_to_detected_object
+{
+using autoware_auto_perception_msgs::msg::TrackedObject;
+using autoware_auto_perception_msgs::msg::TrackedObjects;
+
+// Fusion cycle of detected objects with radar objects of multiple sensors, which is shared by
+// RadarObjectFusionToDetectedObjectNode and the offline replay
+class RadarObjectFusionCycle : public RadarFusionCycle<TrackedObjects>
+{
+public:
+  RadarObjectFusionCycle(const Param & param, const tf2::BufferCore & tf_buffer)
+  : RadarFusionCycle(param, tf_buffer, &RadarObjectFusionCycle::setRadarBatch)
+  {
+  }
+
+  // Lapper
+  static RadarFusionToDetectedObject::RadarInput setRadarInput(
+    const TrackedObject & radar_object, const std_msgs::msg::Header & header_);
+
+  // Pack radar objects into radar data in their frame
+  static bool setRadarBatch(
+    const TrackedObjects & radar_objects, RadarFusionToDetectedObject::RadarBatch & radar_batch);
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_OBJECT_FUSION_CYCLE_HPP_
@@ -17,12 +17,22 @@
 #define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT_NODE_HPP_
 
 #include "radar_fusion_to_detected_object.hpp"
+#include "radar_object_fusion_to_detected_object/fusion_debug_publisher.hpp"
+#include "radar_object_fusion_to_detected_object/fusion_node_param.hpp"
+#include "radar_object_fusion_to_detected_object/loanable_publisher.hpp"
+#include "radar_object_fusion_to_detected_object/radar_object_fusion_cycle.hpp"
+#include "radar_object_fusion_to_detected_object/spsc_queue.hpp"
+#include "radar_object_fusion_to_detected_object/triple_buffer.hpp"
 #include "rclcpp/rclcpp.hpp"
+#include "tf2_ros/buffer.h"
+#include "tf2_ros/transform_listener.h"
 
 #include "autoware_auto_perception_msgs/msg/detected_objects.hpp"
 #include "autoware_auto_perception_msgs/msg/tracked_objects.hpp"
+#include "nav_msgs/msg/odometry.hpp"
+#include "tf2_msgs/msg/tf_message.hpp"
+#include "tier4_debug_msgs/msg/int64_stamped.hpp"
 
-#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
@@ -33,38 +43,75 @@ using autoware_auto_perception_msgs::msg::DetectedObject;
 using autoware_auto_perception_msgs::msg::DetectedObjects;
 using autoware_auto_perception_msgs::msg::TrackedObject;
 using autoware_auto_perception_msgs::msg::TrackedObjects;
+using nav_msgs::msg::Odometry;
 
 class RadarObjectFusionToDetectedObjectNode : public rclcpp::Node
 {
 public:
   explicit RadarObjectFusionToDetectedObjectNode(const rclcpp::NodeOptions & node_options);
 
-  struct NodeParam
+  struct NodeParam : public FusionNodeParam
   {
-    double update_rate_hz{};
+    // Topics of radar objects of each sensor, which are merged in the frame of detected objects
+    std::vector<std::string> radar_input_topics{};
   };
 
+  // Declare parameters of the node with their defaults
+  // These are also used by the offline replay to fuse in the same way as the node.
+  static void declareParams(
+    rclcpp::Node & node, NodeParam & node_param, RadarFusionToDetectedObject::Param & core_param);
+
 private:
   // Subscriber
   rclcpp::Subscription<DetectedObjects>::SharedPtr sub_object_{};
-  rclcpp::Subscription<TrackedObjects>::SharedPtr sub_radar_{};
+  rclcpp::Subscription<Odometry>::SharedPtr sub_odometry_{};
 
   // Callback
-  void onDetectedObjects(const DetectedObjects::ConstSharedPtr msg);
-  void onRadarObjects(const TrackedObjects::ConstSharedPtr msg);
+  void onDetectedObjects(DetectedObjects::UniquePtr msg);
+  void onRadarObjects(const TrackedObjects::ConstSharedPtr msg, const std::size_t radar_index);
+  void onOdometry(const Odometry::ConstSharedPtr msg);
+
+  // Input Handoff
+  // Each input is written by its own subscription and read by the fusion without locks, so that
+  // inputs are received in parallel with fusion under a multi-threaded executor.
+  TripleBuffer<DetectedObjects::SharedPtr> objects_handoff_{};
+  TripleBuffer<Odometry::ConstSharedPtr> odometry_handoff_{};
+  void receiveInputs();
+
+  // Radar Sensor
+  struct RadarSensor
+  {
+    rclcpp::Subscription<TrackedObjects>::SharedPtr subscription{};
+    std::unique_ptr<SpscQueue<TrackedObjects::ConstSharedPtr>> queue{};
+  };
+  std::vector<RadarSensor> radar_sensors_{};
 
-  // Data Buffer
-  DetectedObjects::ConstSharedPtr detected_objects_{};
-  TrackedObjects::ConstSharedPtr radar_objects_{};
+  // Transform of radar objects into the frame of detected objects, which is cached in the core
+  tf2_ros::Buffer tf_buffer_{get_clock()};
+  tf2_ros::TransformListener tf_listener_{tf_buffer_};
+  rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr sub_tf_static_{};
+  void onTfStatic(const tf2_msgs::msg::TFMessage::ConstSharedPtr msg);
+
+  int64_t num_unmatched_objects_{0};
 
   // Publisher
   rclcpp::Publisher<DetectedObjects>::SharedPtr pub_objects_{};
+  LoanablePublisher<DetectedObjects> objects_publisher_{};
+  rclcpp::Publisher<tier4_debug_msgs::msg::Int64Stamped>::SharedPtr pub_unmatched_count_{};
 
   // Timer
   rclcpp::TimerBase::SharedPtr timer_{};
 
   bool isDataReady();
   void onTimer();
+  // Fuse the pending detected objects if paired. If force, they are fused without waiting.
+  void fuse(const bool force = false);
+  void publishObjects(
+    const RadarFusionToDetectedObject::ProcessingTime * processing_time = nullptr);
+
+  // Debug
+  std::unique_ptr<FusionDebugPublisher> debug_publisher_{};
+  void updateDebugPeriod();
 
   // Parameter Server
   OnSetParametersCallbackHandle::SharedPtr set_param_res_;
@@ -75,14 +122,9 @@ private:
   NodeParam node_param_{};
 
   // Core
-  RadarFusionToDetectedObject::Input input_{};
-  RadarFusionToDetectedObject::Output output_{};
+  // Pairing, conversion and fusion shared with the offline replay
   RadarFusionToDetectedObject::Param core_param_{};
-  std::unique_ptr<RadarFusionToDetectedObject> radar_fusion_to_detected_object_{};
-
-  // Lapper
-  RadarFusionToDetectedObject::RadarInput setRadarInput(
-    const TrackedObject & radar_object, const std_msgs::msg::Header & header_);
+  std::unique_ptr<RadarObjectFusionCycle> fusion_cycle_{};
 };
 
 }  // namespace radar_fusion_to_detected_object
@@ -0,0 +1,101 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_TRANSFORM_CACHE_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_TRANSFORM_CACHE_HPP_
+
+#include "tf2/buffer_core.h"
+#include "tf2/exceptions.h"
+
+#include "geometry_msgs/msg/transform_stamped.hpp"
+
+#define EIGEN_MPL2_ONLY
+#include <Eigen/Geometry>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Transforms from radar frames to the frame of detected objects looked up from TF.
+// Radars are fixed on the vehicle, so that only static transforms are accepted, and the transform
+// of each frame pair is looked up once and cached until static transforms are updated.
+// A failed lookup is retried in the next call.
+// This depends only on tf2, so that it is shared by the nodes and the offline replay.
+class RadarTransformCache
+{
+public:
+  explicit RadarTransformCache(const tf2::BufferCore & tf_buffer) : tf_buffer_(tf_buffer) {}
+
+  // Transform from source_frame to target_frame.
+  // Return std::nullopt with the reason in error if it is not available or not static.
+  std::optional<Eigen::Isometry3d> getTransform(
+    const std::string & source_frame, const std::string & target_frame, std::string & error)
+  {
+    if (source_frame == target_frame) {
+      return Eigen::Isometry3d::Identity();
+    }
+
+    // Frame pairs are as few as radars, and are compared in place without allocation
+    for (const auto & entry : entries_) {
+      if (entry.source_frame == source_frame && entry.target_frame == target_frame) {
+        return entry.transform;
+      }
+    }
+
+    geometry_msgs::msg::TransformStamped transform_stamped{};
+    try {
+      transform_stamped =
+        tf_buffer_.lookupTransform(target_frame, source_frame, tf2::TimePointZero);
+    } catch (const tf2::TransformException & e) {
+      error = e.what();
+      return std::nullopt;
+    }
+
+    // The latest transform of a chain with a dynamic transform has its stamp, while that of static
+    // transforms has zero
+    const auto & stamp = transform_stamped.header.stamp;
+    if (stamp.sec != 0 || stamp.nanosec != 0) {
+      error = "The transform is not static, but radars need to be fixed in the target frame";
+      return std::nullopt;
+    }
+
+    const auto & t = transform_stamped.transform.translation;
+    const auto & q = transform_stamped.transform.rotation;
+    Entry entry{};
+    entry.source_frame = source_frame;
+    entry.target_frame = target_frame;
+    entry.transform = Eigen::Translation3d(t.x, t.y, t.z) * Eigen::Quaterniond(q.w, q.x, q.y, q.z);
+    entries_.push_back(entry);
+    return entry.transform;
+  }
+
+  // Drop cached transforms, which is called when static transforms are updated
+  void clear() { entries_.clear(); }
+
+private:
+  struct Entry
+  {
+    std::string source_frame{};
+    std::string target_frame{};
+    Eigen::Isometry3d transform{Eigen::Isometry3d::Identity()};
+  };
+
+  const tf2::BufferCore & tf_buffer_;
+  std::vector<Entry> entries_{};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__RADAR_TRANSFORM_CACHE_HPP_
@@ -0,0 +1,92 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__SLIDING_WINDOW_STATISTICS_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__SLIDING_WINDOW_STATISTICS_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Nearest-rank percentile of sorted values, which is one of the values. Return 0 if empty.
+inline double getNearestRankPercentile(
+  const std::vector<double> & sorted_values, const double ratio)
+{
+  if (sorted_values.empty()) {
+    return 0.0;
+  }
+  const auto rank =
+    static_cast<std::size_t>(std::ceil(ratio * static_cast<double>(sorted_values.size())));
+  return sorted_values.at(std::max<std::size_t>(rank, 1) - 1);
+}
+
+// Percentiles of the latest samples.
+// Samples are stored in a fixed-size ring, and sorted only when the summary is requested.
+class SlidingWindowStatistics
+{
+public:
+  struct Summary
+  {
+    std::size_t count{};
+    double p50{};
+    double p99{};
+    double max{};
+  };
+
+  explicit SlidingWindowStatistics(const std::size_t window_size = 100)
+  : samples_(std::max<std::size_t>(window_size, 1))
+  {
+  }
+
+  void add(const double value)
+  {
+    samples_.at(head_) = value;
+    head_ = (head_ + 1) % samples_.size();
+    size_ = std::min(size_ + 1, samples_.size());
+  }
+
+  Summary summarize()
+  {
+    Summary summary{};
+    summary.count = size_;
+    if (size_ == 0) {
+      return summary;
+    }
+
+    sorted_.assign(samples_.begin(), samples_.begin() + static_cast<std::ptrdiff_t>(size_));
+    std::sort(sorted_.begin(), sorted_.end());
+    summary.p50 = getNearestRankPercentile(sorted_, 0.50);
+    summary.p99 = getNearestRankPercentile(sorted_, 0.99);
+    summary.max = sorted_.back();
+    return summary;
+  }
+
+  void clear()
+  {
+    head_ = 0;
+    size_ = 0;
+  }
+
+private:
+  std::vector<double> samples_;
+  std::vector<double> sorted_{};
+  std::size_t head_{0};
+  std::size_t size_{0};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__SLIDING_WINDOW_STATISTICS_HPP_
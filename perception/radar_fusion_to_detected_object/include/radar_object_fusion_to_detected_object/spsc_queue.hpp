@@ -0,0 +1,70 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__SPSC_QUEUE_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+// Lock-free bounded queue from a single producer thread to a single consumer thread.
+// The storage is allocated at construction, and push() fails if the queue is full.
+template <class T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(const std::size_t capacity) : buffer_(capacity + 1) {}
+
+  // Producer: return false if the queue is full
+  bool push(T value)
+  {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t next = (tail + 1) % buffer_.size();
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    buffer_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer: return false if the queue is empty
+  bool pop(T & value)
+  {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(buffer_[head]);
+    buffer_[head] = T{};
+    head_.store((head + 1) % buffer_.size(), std::memory_order_release);
+    return true;
+  }
+
+  std::size_t capacity() const { return buffer_.size() - 1; }
+
+private:
+  std::vector<T> buffer_;
+  // Written by the consumer
+  alignas(64) std::atomic<std::size_t> head_{0};
+  // Written by the producer
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__SPSC_QUEUE_HPP_
@@ -0,0 +1,101 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__STAMPED_RING_BUFFER_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__STAMPED_RING_BUFFER_HPP_
+
+#include "builtin_interfaces/msg/time.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+inline int64_t toNanoseconds(const builtin_interfaces::msg::Time & stamp)
+{
+  return static_cast<int64_t>(stamp.sec) * 1000000000LL + static_cast<int64_t>(stamp.nanosec);
+}
+
+// Fixed-capacity buffer of the latest messages with header.
+// The storage is allocated at construction, and the oldest message is overwritten when full.
+template <class MsgT>
+class StampedRingBuffer
+{
+public:
+  using ConstSharedPtr = typename MsgT::ConstSharedPtr;
+
+  explicit StampedRingBuffer(const std::size_t capacity)
+  : buffer_(std::max<std::size_t>(capacity, 1))
+  {
+  }
+
+  void push(const ConstSharedPtr & msg)
+  {
+    buffer_.at(head_) = msg;
+    head_ = (head_ + 1) % buffer_.size();
+    size_ = std::min(size_ + 1, buffer_.size());
+  }
+
+  // Message whose stamp is nearest to stamp_ns within tolerance_ns. Return nullptr if not found.
+  ConstSharedPtr findNearest(const int64_t stamp_ns, const int64_t tolerance_ns) const
+  {
+    ConstSharedPtr nearest{};
+    int64_t min_diff = tolerance_ns;
+    for (std::size_t i = 0; i < size_; ++i) {
+      const auto & msg = buffer_.at(i);
+      const int64_t diff = std::llabs(toNanoseconds(msg->header.stamp) - stamp_ns);
+      if (diff > min_diff) {
+        continue;
+      }
+      // Prefer the newer message if the difference is same
+      if (
+        !nearest || diff < min_diff ||
+        toNanoseconds(nearest->header.stamp) < toNanoseconds(msg->header.stamp)) {
+        nearest = msg;
+        min_diff = diff;
+      }
+    }
+    return nearest;
+  }
+
+  ConstSharedPtr latest() const
+  {
+    if (size_ == 0) {
+      return ConstSharedPtr{};
+    }
+    return buffer_.at((head_ + buffer_.size() - 1) % buffer_.size());
+  }
+
+  bool empty() const { return size_ == 0; }
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return buffer_.size(); }
+
+  void clear()
+  {
+    std::fill(buffer_.begin(), buffer_.end(), ConstSharedPtr{});
+    head_ = 0;
+    size_ = 0;
+  }
+
+private:
+  std::vector<ConstSharedPtr> buffer_;
+  std::size_t head_{0};
+  std::size_t size_{0};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__STAMPED_RING_BUFFER_HPP_
@@ -0,0 +1,70 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__TRIPLE_BUFFER_HPP_
+#define RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__TRIPLE_BUFFER_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace radar_fusion_to_detected_object
+{
+// Lock-free handoff of the latest value from a single writer thread to a single reader thread.
+// The writer and the reader own one buffer each, and exchange it with the middle buffer atomically,
+// so that neither waits for the other. Values not read before the next write are dropped.
+template <class T>
+class TripleBuffer
+{
+public:
+  // Writer: publish value as the latest
+  void write(T value)
+  {
+    buffers_[back_] = std::move(value);
+    const uint8_t previous =
+      middle_.exchange(static_cast<uint8_t>(back_ | fresh_bit), std::memory_order_acq_rel);
+    back_ = previous & index_mask;
+  }
+
+  // Reader: switch the front buffer to the latest value if it was written after the last update.
+  // Return true if switched.
+  bool update()
+  {
+    if ((middle_.load(std::memory_order_relaxed) & fresh_bit) == 0) {
+      return false;
+    }
+    const uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & index_mask;
+    return true;
+  }
+
+  // Reader: the value of the last update()
+  T & front() { return buffers_[front_]; }
+
+private:
+  static constexpr uint8_t index_mask = 0x3;
+  static constexpr uint8_t fresh_bit = 0x4;
+
+  std::array<T, 3> buffers_{};
+  // Index of the buffer owned by the reader
+  uint8_t front_{0};
+  // Index of the buffer shared between the writer and the reader, and whether it is fresh
+  alignas(64) std::atomic<uint8_t> middle_{1};
+  // Index of the buffer owned by the writer
+  alignas(64) uint8_t back_{2};
+};
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_OBJECT_FUSION_TO_DETECTED_OBJECT__TRIPLE_BUFFER_HPP_
@@ -0,0 +1,117 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RADAR_SCAN_FUSION_TO_DETECTED_OBJECT__RADAR_SCAN_FUSION_TO_DETECTED_OBJECT_NODE_HPP_
+#define RADAR_SCAN_FUSION_TO_DETECTED_OBJECT__RADAR_SCAN_FUSION_TO_DETECTED_OBJECT_NODE_HPP_
+
+#include "radar_fusion_to_detected_object.hpp"
+#include "radar_object_fusion_to_detected_object/fusion_debug_publisher.hpp"
+#include "radar_object_fusion_to_detected_object/fusion_node_param.hpp"
+#include "radar_object_fusion_to_detected_object/loanable_publisher.hpp"
+#include "radar_object_fusion_to_detected_object/radar_fusion_cycle.hpp"
+#include "radar_object_fusion_to_detected_object/spsc_queue.hpp"
+#include "radar_object_fusion_to_detected_object/triple_buffer.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "tf2_ros/buffer.h"
+#include "tf2_ros/transform_listener.h"
+
+#include "autoware_auto_perception_msgs/msg/detected_objects.hpp"
+#include "nav_msgs/msg/odometry.hpp"
+#include "sensor_msgs/msg/point_cloud2.hpp"
+#include "tf2_msgs/msg/tf_message.hpp"
+#include "tier4_debug_msgs/msg/int64_stamped.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace radar_fusion_to_detected_object
+{
+using autoware_auto_perception_msgs::msg::DetectedObjects;
+using nav_msgs::msg::Odometry;
+using sensor_msgs::msg::PointCloud2;
+
+class RadarScanFusionToDetectedObjectNode : public rclcpp::Node
+{
+public:
+  explicit RadarScanFusionToDetectedObjectNode(const rclcpp::NodeOptions & node_options);
+
+  using NodeParam = FusionNodeParam;
+
+private:
+  // Subscriber
+  rclcpp::Subscription<DetectedObjects>::SharedPtr sub_object_{};
+  rclcpp::Subscription<PointCloud2>::SharedPtr sub_radar_{};
+  rclcpp::Subscription<Odometry>::SharedPtr sub_odometry_{};
+
+  // Callback
+  void onDetectedObjects(DetectedObjects::UniquePtr msg);
+  void onRadarScan(const PointCloud2::ConstSharedPtr msg);
+  void onOdometry(const Odometry::ConstSharedPtr msg);
+
+  // Input Handoff
+  // Each input is written by its own subscription and read by the fusion without locks
+  TripleBuffer<DetectedObjects::SharedPtr> objects_handoff_{};
+  std::unique_ptr<SpscQueue<PointCloud2::ConstSharedPtr>> radar_queue_{};
+  TripleBuffer<Odometry::ConstSharedPtr> odometry_handoff_{};
+  void receiveInputs();
+
+  // Transform of radar scans into the frame of detected objects, which is cached in the core
+  tf2_ros::Buffer tf_buffer_{get_clock()};
+  tf2_ros::TransformListener tf_listener_{tf_buffer_};
+  rclcpp::Subscription<tf2_msgs::msg::TFMessage>::SharedPtr sub_tf_static_{};
+  void onTfStatic(const tf2_msgs::msg::TFMessage::ConstSharedPtr msg);
+
+  int64_t num_unmatched_objects_{0};
+
+  // Publisher
+  rclcpp::Publisher<DetectedObjects>::SharedPtr pub_objects_{};
+  LoanablePublisher<DetectedObjects> objects_publisher_{};
+  rclcpp::Publisher<tier4_debug_msgs::msg::Int64Stamped>::SharedPtr pub_unmatched_count_{};
+
+  // Timer
+  rclcpp::TimerBase::SharedPtr timer_{};
+
+  bool isDataReady();
+  void onTimer();
+  // Fuse the pending detected objects if paired. If force, they are fused without waiting.
+  void fuse(const bool force = false);
+  void publishObjects(
+    const RadarFusionToDetectedObject::ProcessingTime * processing_time = nullptr);
+
+  // Debug
+  std::unique_ptr<FusionDebugPublisher> debug_publisher_{};
+  void updateDebugPeriod();
+
+  // Parameter Server
+  OnSetParametersCallbackHandle::SharedPtr set_param_res_;
+  rcl_interfaces::msg::SetParametersResult onSetParam(
+    const std::vector<rclcpp::Parameter> & params);
+
+  // Parameter
+  NodeParam node_param_{};
+
+  // Core
+  // Pairing, conversion and fusion shared with radar objects
+  RadarFusionToDetectedObject::Param core_param_{};
+  std::unique_ptr<RadarFusionCycle<PointCloud2>> fusion_cycle_{};
+
+  // Convert radar scan to the batch of the core. This is called by fusion_cycle_.
+  bool setRadarBatch(
+    const PointCloud2 & radar_scan, RadarFusionToDetectedObject::RadarBatch & radar_batch);
+};
+
+}  // namespace radar_fusion_to_detected_object
+
+#endif  // RADAR_SCAN_FUSION_TO_DETECTED_OBJECT__RADAR_SCAN_FUSION_TO_DETECTED_OBJECT_NODE_HPP_
@@ -0,0 +1,59 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_fusion_to_detected_object/cycle_arena.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+
+namespace radar_fusion_to_detected_object
+{
+CycleArena::CycleArena(const std::size_t initial_size)
+: buffer_(std::max<std::size_t>(initial_size, 1))
+{
+  resource_.emplace(buffer_.data(), buffer_.size(), &upstream_);
+}
+
+void CycleArena::reset()
+{
+  // Destroying the monotonic resource returns fallback memory to the global allocator
+  const std::size_t upstream_bytes = upstream_.allocated_bytes;
+  resource_.reset();
+  if (upstream_bytes > 0) {
+    buffer_.resize(2 * (buffer_.size() + upstream_bytes));
+  }
+  upstream_.allocation_count = 0;
+  upstream_.allocated_bytes = 0;
+  resource_.emplace(buffer_.data(), buffer_.size(), &upstream_);
+}
+
+void * CycleArena::CountingResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+  ++allocation_count;
+  allocated_bytes += bytes;
+  return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void CycleArena::CountingResource::do_deallocate(void * p, std::size_t bytes, std::size_t alignment)
+{
+  std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool CycleArena::CountingResource::do_is_equal(
+  const std::pmr::memory_resource & other) const noexcept
+{
+  return this == &other;
+}
+}  // namespace radar_fusion_to_detected_object
@@ -0,0 +1,349 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_fusion_to_detected_object/point_in_box_kernel.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RADAR_FUSION_POINT_IN_BOX_AVX2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RADAR_FUSION_POINT_IN_BOX_NEON
+#endif
+
+namespace radar_fusion_to_detected_object
+{
+namespace
+{
+template <typename T>
+using FilterFunc = void (*)(
+  const OrientedBox2d &, const T *, const T *, const std::size_t, std::pmr::vector<std::size_t> &);
+
+// All kernels use the same operation order as this function without FMA, so that the results of
+// SIMD kernels are same as the scalar kernel. The box is converted to the scalar type of points.
+template <typename T>
+inline bool isWithinBox(const OrientedBox2d & box, const T x, const T y)
+{
+  const T cos_yaw = static_cast<T>(box.cos_yaw);
+  const T sin_yaw = static_cast<T>(box.sin_yaw);
+  const T dx = x - static_cast<T>(box.center_x);
+  const T dy = y - static_cast<T>(box.center_y);
+  const T local_x = cos_yaw * dx + sin_yaw * dy;
+  const T local_y = cos_yaw * dy - sin_yaw * dx;
+  return std::abs(local_x) < static_cast<T>(box.half_length) &&
+         std::abs(local_y) < static_cast<T>(box.half_width);
+}
+
+template <typename T>
+void filterPointsWithinBoxScalarImpl(
+  const OrientedBox2d & box, const T * xs, const T * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices)
+{
+  for (std::size_t i = 0; i < size; ++i) {
+    if (isWithinBox(box, xs[i], ys[i])) {
+      indices.push_back(i);
+    }
+  }
+}
+
+template <typename T>
+void filterCandidatesWithinBox(
+  const OrientedBox2d & box, const T * xs, const T * ys, const std::size_t * candidates,
+  const std::size_t num_candidates, std::pmr::vector<std::size_t> & indices)
+{
+  for (std::size_t i = 0; i < num_candidates; ++i) {
+    const std::size_t index = candidates[i];
+    if (isWithinBox(box, xs[index], ys[index])) {
+      indices.push_back(index);
+    }
+  }
+}
+
+#ifdef RADAR_FUSION_POINT_IN_BOX_AVX2
+__attribute__((target("avx2"))) void filterPointsWithinBoxAvx2(
+  const OrientedBox2d & box, const double * xs, const double * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices)
+{
+  const __m256d center_x = _mm256_set1_pd(box.center_x);
+  const __m256d center_y = _mm256_set1_pd(box.center_y);
+  const __m256d cos_yaw = _mm256_set1_pd(box.cos_yaw);
+  const __m256d sin_yaw = _mm256_set1_pd(box.sin_yaw);
+  const __m256d half_length = _mm256_set1_pd(box.half_length);
+  const __m256d half_width = _mm256_set1_pd(box.half_width);
+  const __m256d sign_mask = _mm256_set1_pd(-0.0);
+
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + i), center_x);
+    const __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + i), center_y);
+    const __m256d local_x =
+      _mm256_add_pd(_mm256_mul_pd(cos_yaw, dx), _mm256_mul_pd(sin_yaw, dy));
+    const __m256d local_y =
+      _mm256_sub_pd(_mm256_mul_pd(cos_yaw, dy), _mm256_mul_pd(sin_yaw, dx));
+    const __m256d within_x =
+      _mm256_cmp_pd(_mm256_andnot_pd(sign_mask, local_x), half_length, _CMP_LT_OQ);
+    const __m256d within_y =
+      _mm256_cmp_pd(_mm256_andnot_pd(sign_mask, local_y), half_width, _CMP_LT_OQ);
+    int mask = _mm256_movemask_pd(_mm256_and_pd(within_x, within_y));
+    while (mask != 0) {
+      indices.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  for (; i < size; ++i) {
+    if (isWithinBox(box, xs[i], ys[i])) {
+      indices.push_back(i);
+    }
+  }
+}
+
+__attribute__((target("avx2"))) void filterPointsWithinBoxAvx2(
+  const OrientedBox2d & box, const float * xs, const float * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices)
+{
+  const __m256 center_x = _mm256_set1_ps(static_cast<float>(box.center_x));
+  const __m256 center_y = _mm256_set1_ps(static_cast<float>(box.center_y));
+  const __m256 cos_yaw = _mm256_set1_ps(static_cast<float>(box.cos_yaw));
+  const __m256 sin_yaw = _mm256_set1_ps(static_cast<float>(box.sin_yaw));
+  const __m256 half_length = _mm256_set1_ps(static_cast<float>(box.half_length));
+  const __m256 half_width = _mm256_set1_ps(static_cast<float>(box.half_width));
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), center_x);
+    const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), center_y);
+    const __m256 local_x = _mm256_add_ps(_mm256_mul_ps(cos_yaw, dx), _mm256_mul_ps(sin_yaw, dy));
+    const __m256 local_y = _mm256_sub_ps(_mm256_mul_ps(cos_yaw, dy), _mm256_mul_ps(sin_yaw, dx));
+    const __m256 within_x =
+      _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, local_x), half_length, _CMP_LT_OQ);
+    const __m256 within_y =
+      _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, local_y), half_width, _CMP_LT_OQ);
+    int mask = _mm256_movemask_ps(_mm256_and_ps(within_x, within_y));
+    while (mask != 0) {
+      indices.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  for (; i < size; ++i) {
+    if (isWithinBox(box, xs[i], ys[i])) {
+      indices.push_back(i);
+    }
+  }
+}
+#endif
+
+#ifdef RADAR_FUSION_POINT_IN_BOX_NEON
+void filterPointsWithinBoxNeon(
+  const OrientedBox2d & box, const double * xs, const double * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices)
+{
+  const float64x2_t center_x = vdupq_n_f64(box.center_x);
+  const float64x2_t center_y = vdupq_n_f64(box.center_y);
+  const float64x2_t cos_yaw = vdupq_n_f64(box.cos_yaw);
+  const float64x2_t sin_yaw = vdupq_n_f64(box.sin_yaw);
+  const float64x2_t half_length = vdupq_n_f64(box.half_length);
+  const float64x2_t half_width = vdupq_n_f64(box.half_width);
+
+  std::size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    const float64x2_t dx = vsubq_f64(vld1q_f64(xs + i), center_x);
+    const float64x2_t dy = vsubq_f64(vld1q_f64(ys + i), center_y);
+    const float64x2_t local_x = vaddq_f64(vmulq_f64(cos_yaw, dx), vmulq_f64(sin_yaw, dy));
+    const float64x2_t local_y = vsubq_f64(vmulq_f64(cos_yaw, dy), vmulq_f64(sin_yaw, dx));
+    const uint64x2_t within = vandq_u64(
+      vcltq_f64(vabsq_f64(local_x), half_length), vcltq_f64(vabsq_f64(local_y), half_width));
+    if (vgetq_lane_u64(within, 0) != 0) {
+      indices.push_back(i);
+    }
+    if (vgetq_lane_u64(within, 1) != 0) {
+      indices.push_back(i + 1);
+    }
+  }
+  for (; i < size; ++i) {
+    if (isWithinBox(box, xs[i], ys[i])) {
+      indices.push_back(i);
+    }
+  }
+}
+
+void filterPointsWithinBoxNeon(
+  const OrientedBox2d & box, const float * xs, const float * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices)
+{
+  const float32x4_t center_x = vdupq_n_f32(static_cast<float>(box.center_x));
+  const float32x4_t center_y = vdupq_n_f32(static_cast<float>(box.center_y));
+  const float32x4_t cos_yaw = vdupq_n_f32(static_cast<float>(box.cos_yaw));
+  const float32x4_t sin_yaw = vdupq_n_f32(static_cast<float>(box.sin_yaw));
+  const float32x4_t half_length = vdupq_n_f32(static_cast<float>(box.half_length));
+  const float32x4_t half_width = vdupq_n_f32(static_cast<float>(box.half_width));
+
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    const float32x4_t dx = vsubq_f32(vld1q_f32(xs + i), center_x);
+    const float32x4_t dy = vsubq_f32(vld1q_f32(ys + i), center_y);
+    const float32x4_t local_x = vaddq_f32(vmulq_f32(cos_yaw, dx), vmulq_f32(sin_yaw, dy));
+    const float32x4_t local_y = vsubq_f32(vmulq_f32(cos_yaw, dy), vmulq_f32(sin_yaw, dx));
+    const uint32x4_t within = vandq_u32(
+      vcltq_f32(vabsq_f32(local_x), half_length), vcltq_f32(vabsq_f32(local_y), half_width));
+    if (vmaxvq_u32(within) == 0) {
+      continue;
+    }
+    if (vgetq_lane_u32(within, 0) != 0) {
+      indices.push_back(i);
+    }
+    if (vgetq_lane_u32(within, 1) != 0) {
+      indices.push_back(i + 1);
+    }
+    if (vgetq_lane_u32(within, 2) != 0) {
+      indices.push_back(i + 2);
+    }
+    if (vgetq_lane_u32(within, 3) != 0) {
+      indices.push_back(i + 3);
+    }
+  }
+  for (; i < size; ++i) {
+    if (isWithinBox(box, xs[i], ys[i])) {
+      indices.push_back(i);
+    }
+  }
+}
+#endif
+
+PointInBoxKernel selectKernel()
+{
+#ifdef RADAR_FUSION_POINT_IN_BOX_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return PointInBoxKernel::AVX2;
+  }
+#endif
+#ifdef RADAR_FUSION_POINT_IN_BOX_NEON
+  return PointInBoxKernel::NEON;
+#endif
+  return PointInBoxKernel::SCALAR;
+}
+
+template <typename T>
+FilterFunc<T> getFilterFunc(const PointInBoxKernel kernel)
+{
+  switch (kernel) {
+#ifdef RADAR_FUSION_POINT_IN_BOX_AVX2
+    case PointInBoxKernel::AVX2:
+      return filterPointsWithinBoxAvx2;
+#endif
+#ifdef RADAR_FUSION_POINT_IN_BOX_NEON
+    case PointInBoxKernel::NEON:
+      return filterPointsWithinBoxNeon;
+#endif
+    default:
+      return filterPointsWithinBoxScalarImpl;
+  }
+}
+}  // namespace
+
+OrientedBox2d createOrientedBox2d(
+  const double center_x, const double center_y, const double yaw, const double length,
+  const double width, const double margin)
+{
+  OrientedBox2d box{};
+  box.center_x = center_x;
+  box.center_y = center_y;
+  box.cos_yaw = std::cos(yaw);
+  box.sin_yaw = std::sin(yaw);
+  box.half_length = length / 2.0 + margin;
+  box.half_width = width / 2.0 + margin;
+  return box;
+}
+
+void getEnvelopeHalfSize(const OrientedBox2d & box, double & half_size_x, double & half_size_y)
+{
+  half_size_x = std::abs(box.cos_yaw) * box.half_length + std::abs(box.sin_yaw) * box.half_width;
+  half_size_y = std::abs(box.sin_yaw) * box.half_length + std::abs(box.cos_yaw) * box.half_width;
+}
+
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const double * xs, const double * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices)
+{
+  static const FilterFunc<double> filter_func = getFilterFunc<double>(getPointInBoxKernel());
+  filter_func(box, xs, ys, size, indices);
+}
+
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const float * xs, const float * ys, const std::size_t size,
+  std::pmr::vector<std::size_t> & indices)
+{
+  static const FilterFunc<float> filter_func = getFilterFunc<float>(getPointInBoxKernel());
+  filter_func(box, xs, ys, size, indices);
+}
+
+// Candidates are few after the grid query, so that gathering them into SIMD registers does not pay
+// off and they are checked one by one.
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const double * xs, const double * ys, const std::size_t * candidates,
+  const std::size_t num_candidates, std::pmr::vector<std::size_t> & indices)
+{
+  filterCandidatesWithinBox(box, xs, ys, candidates, num_candidates, indices);
+}
+
+void filterPointsWithinBox(
+  const OrientedBox2d & box, const float * xs, const float * ys, const std::size_t * candidates,
+  const std::size_t num_candidates, std::pmr::vector<std::size_t> & indices)
+{
+  filterCandidatesWithinBox(box, xs, ys, candidates, num_candidates, indices);
+}
+
+PointInBoxKernel getPointInBoxKernel()
+{
+  static const PointInBoxKernel kernel = selectKernel();
+  return kernel;
+}
+
+bool isPointInBoxKernelAvailable(const PointInBoxKernel kernel)
+{
+  switch (kernel) {
+    case PointInBoxKernel::SCALAR:
+      return true;
+#ifdef RADAR_FUSION_POINT_IN_BOX_AVX2
+    case PointInBoxKernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+#ifdef RADAR_FUSION_POINT_IN_BOX_NEON
+    case PointInBoxKernel::NEON:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+void filterPointsWithinBox(
+  const PointInBoxKernel kernel, const OrientedBox2d & box, const double * xs, const double * ys,
+  const std::size_t size, std::pmr::vector<std::size_t> & indices)
+{
+  getFilterFunc<double>(kernel)(box, xs, ys, size, indices);
+}
+
+void filterPointsWithinBox(
+  const PointInBoxKernel kernel, const OrientedBox2d & box, const float * xs, const float * ys,
+  const std::size_t size, std::pmr::vector<std::size_t> & indices)
+{
+  getFilterFunc<float>(kernel)(box, xs, ys, size, indices);
+}
+}  // namespace radar_fusion_to_detected_object
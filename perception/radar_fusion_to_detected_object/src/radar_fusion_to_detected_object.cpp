@@ -15,13 +15,17 @@
 
 #include "radar_fusion_to_detected_object.hpp"
 
-#include <boost/geometry.hpp>
-
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <memory>
 #include <numeric>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace radar_fusion_to_detected_object
@@ -32,8 +36,42 @@ using geometry_msgs::msg::Point;
 using geometry_msgs::msg::PoseWithCovariance;
 using geometry_msgs::msg::Twist;
 using geometry_msgs::msg::TwistWithCovariance;
-using tier4_autoware_utils::LinearRing2d;
-using tier4_autoware_utils::Point2d;
+
+namespace
+{
+class LapTimer
+{
+public:
+  // Time from the last lap [ms]
+  double lap()
+  {
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(now - last_).count();
+    last_ = now;
+    return elapsed_ms;
+  }
+
+private:
+  std::chrono::steady_clock::time_point last_{std::chrono::steady_clock::now()};
+};
+
+// Doppler velocity is not converted to twist if the line of sight is almost perpendicular to the
+// heading of the object (about 80 deg or more), because the converted speed diverges.
+constexpr double min_doppler_projection = 0.17;
+
+// Yaw of quaternion in the same way as tf2::getYaw, which is not used to keep the core library
+// independent of tf2_ros and rclcpp
+double getYaw(const geometry_msgs::msg::Quaternion & q)
+{
+  const double s = 2.0 / (q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  return std::atan2((q.x * q.y + q.w * q.z) * s, 1.0 - (q.y * q.y + q.z * q.z) * s);
+}
+}  // namespace
+
+RadarFusionToDetectedObject::RadarFusionToDetectedObject()
+{
+  worker_contexts_.push_back(std::make_unique<WorkerContext>());
+}
 
 void RadarFusionToDetectedObject::setParam(const Param & param)
 {
@@ -42,6 +80,29 @@ void RadarFusionToDetectedObject::setParam(const Param & param)
   param_.split_threshold_velocity = param.split_threshold_velocity;
   param_.threshold_yaw_diff = param.split_threshold_velocity;
 
+  // Spatial index param
+  param_.use_grid_index = param.use_grid_index;
+  param_.grid_cell_size = param.grid_cell_size;
+
+  // Compensation param
+  param_.compensate_radar_motion = param.compensate_radar_motion;
+
+  // Precision param
+  param_.use_single_precision = param.use_single_precision;
+
+  // Thread param
+  param_.num_threads = param.num_threads;
+  std::size_t num_threads = param.num_threads > 0 ? static_cast<std::size_t>(param.num_threads)
+                                                  : std::thread::hardware_concurrency();
+  num_threads = std::max<std::size_t>(num_threads, 1);
+  if (thread_pool_->getNumThreads() != num_threads) {
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads);
+  }
+  worker_contexts_.resize(std::min(worker_contexts_.size(), num_threads));
+  while (worker_contexts_.size() < num_threads) {
+    worker_contexts_.push_back(std::make_unique<WorkerContext>());
+  }
+
   // Normalize weight param
   double sum_weight = param.velocity_weight_median + param.velocity_weight_min_distance +
                       param.velocity_weight_average + param.velocity_weight_target_value_average +
@@ -62,11 +123,191 @@ void RadarFusionToDetectedObject::setParam(const Param & param)
     param_.velocity_weight_target_value_top = param.velocity_weight_target_value_top / sum_weight;
   }
 
+  // Select the twist estimation specialized for the strategies in use
+  static const auto weighted_twist_estimators =
+    makeWeightedTwistEstimators<double>(std::make_index_sequence<num_weight_strategy_masks>{});
+  static const auto weighted_twist_estimators_f =
+    makeWeightedTwistEstimators<float>(std::make_index_sequence<num_weight_strategy_masks>{});
+  unsigned int strategies = 0;
+  strategies |= param_.velocity_weight_min_distance > 0.0 ? MIN_DISTANCE : 0U;
+  strategies |= param_.velocity_weight_median > 0.0 ? MEDIAN : 0U;
+  strategies |= param_.velocity_weight_average > 0.0 ? AVERAGE : 0U;
+  strategies |= param_.velocity_weight_target_value_top > 0.0 ? TARGET_VALUE_TOP : 0U;
+  strategies |= param_.velocity_weight_target_value_average > 0.0 ? TARGET_VALUE_AVERAGE : 0U;
+  estimate_weighted_twist_ = weighted_twist_estimators[strategies];
+  estimate_weighted_twist_f_ = weighted_twist_estimators_f[strategies];
+
+  // Least squares param
+  param_.use_doppler_least_squares = param.use_doppler_least_squares;
+  param_.threshold_doppler_condition = param.threshold_doppler_condition;
+
   // Parameters for fixing object information
   param_.threshold_probability = param.threshold_probability;
   param_.convert_doppler_to_twist = param.convert_doppler_to_twist;
 }
 
+template <typename T>
+void RadarFusionToDetectedObject::BasicRadarBatch<T>::clear()
+{
+  x.clear();
+  y.clear();
+  vx.clear();
+  vy.clear();
+  vz.clear();
+  los_x.clear();
+  los_y.clear();
+  doppler.clear();
+  target_value.clear();
+  source_index.clear();
+}
+
+template <typename T>
+void RadarFusionToDetectedObject::BasicRadarBatch<T>::reserve(const std::size_t size)
+{
+  x.reserve(size);
+  y.reserve(size);
+  vx.reserve(size);
+  vy.reserve(size);
+  vz.reserve(size);
+  los_x.reserve(size);
+  los_y.reserve(size);
+  doppler.reserve(size);
+  target_value.reserve(size);
+  source_index.reserve(size);
+}
+
+template <typename T>
+void RadarFusionToDetectedObject::BasicRadarBatch<T>::push_back(
+  const RadarInput & radar, const std::size_t index)
+{
+  const auto & position = radar.pose_with_covariance->pose.position;
+  const auto & linear = radar.twist_with_covariance->twist.linear;
+  x.push_back(static_cast<T>(position.x));
+  y.push_back(static_cast<T>(position.y));
+  vx.push_back(static_cast<T>(linear.x));
+  vy.push_back(static_cast<T>(linear.y));
+  vz.push_back(static_cast<T>(linear.z));
+
+  // Doppler velocity is the twist projected on the line of sight
+  const double range = std::hypot(position.x, position.y);
+  const double los_x_value = range > 0.0 ? position.x / range : 0.0;
+  const double los_y_value = range > 0.0 ? position.y / range : 0.0;
+  los_x.push_back(static_cast<T>(los_x_value));
+  los_y.push_back(static_cast<T>(los_y_value));
+  doppler.push_back(static_cast<T>(linear.x * los_x_value + linear.y * los_y_value));
+
+  target_value.push_back(static_cast<T>(radar.target_value));
+  source_index.push_back(index);
+}
+
+template <typename T>
+void RadarFusionToDetectedObject::BasicRadarBatch<T>::push_back_polar(
+  const double range, const double azimuth, const double doppler_velocity,
+  const double target_value_, const std::size_t index)
+{
+  const double cos_azimuth = std::cos(azimuth);
+  const double sin_azimuth = std::sin(azimuth);
+  x.push_back(static_cast<T>(range * cos_azimuth));
+  y.push_back(static_cast<T>(range * sin_azimuth));
+
+  // Twist is only the doppler velocity along the line of sight
+  vx.push_back(static_cast<T>(doppler_velocity * cos_azimuth));
+  vy.push_back(static_cast<T>(doppler_velocity * sin_azimuth));
+  vz.push_back(T{0});
+  los_x.push_back(static_cast<T>(cos_azimuth));
+  los_y.push_back(static_cast<T>(sin_azimuth));
+  doppler.push_back(static_cast<T>(doppler_velocity));
+
+  target_value.push_back(static_cast<T>(target_value_));
+  source_index.push_back(index);
+}
+
+template <typename T>
+template <typename U>
+void RadarFusionToDetectedObject::BasicRadarBatch<T>::assign(const BasicRadarBatch<U> & other)
+{
+  auto assign_column = [](std::vector<T> & column, const std::vector<U> & other_column) {
+    column.assign(other_column.begin(), other_column.end());
+  };
+  assign_column(x, other.x);
+  assign_column(y, other.y);
+  assign_column(vx, other.vx);
+  assign_column(vy, other.vy);
+  assign_column(vz, other.vz);
+  assign_column(los_x, other.los_x);
+  assign_column(los_y, other.los_y);
+  assign_column(doppler, other.doppler);
+  assign_column(target_value, other.target_value);
+  source_index = other.source_index;
+}
+
+template <typename T>
+void RadarFusionToDetectedObject::BasicRadarBatch<T>::append(const BasicRadarBatch & other)
+{
+  auto append_column = [](auto & column, const auto & other_column) {
+    column.insert(column.end(), other_column.begin(), other_column.end());
+  };
+  append_column(x, other.x);
+  append_column(y, other.y);
+  append_column(vx, other.vx);
+  append_column(vy, other.vy);
+  append_column(vz, other.vz);
+  append_column(los_x, other.los_x);
+  append_column(los_y, other.los_y);
+  append_column(doppler, other.doppler);
+  append_column(target_value, other.target_value);
+  append_column(source_index, other.source_index);
+}
+
+// Each group of columns is transformed in its own loop with the coefficients in T, so that the
+// loops are vectorized in the lanes of T with few aliasing checks
+template <typename T>
+void RadarFusionToDetectedObject::BasicRadarBatch<T>::transform(
+  const Eigen::Isometry3d & transform, const std::size_t begin, const std::size_t end)
+{
+  const Eigen::Matrix<T, 3, 3> r = transform.linear().template cast<T>();
+  const T tx = static_cast<T>(transform.translation().x());
+  const T ty = static_cast<T>(transform.translation().y());
+
+  // Position
+  T * x_data = x.data();
+  T * y_data = y.data();
+  for (std::size_t i = begin; i < end; ++i) {
+    const T px = x_data[i];
+    const T py = y_data[i];
+    x_data[i] = r(0, 0) * px + r(0, 1) * py + tx;
+    y_data[i] = r(1, 0) * px + r(1, 1) * py + ty;
+  }
+
+  // Velocity
+  T * vx_data = vx.data();
+  T * vy_data = vy.data();
+  T * vz_data = vz.data();
+  for (std::size_t i = begin; i < end; ++i) {
+    const T v0 = vx_data[i];
+    const T v1 = vy_data[i];
+    const T v2 = vz_data[i];
+    vx_data[i] = r(0, 0) * v0 + r(0, 1) * v1 + r(0, 2) * v2;
+    vy_data[i] = r(1, 0) * v0 + r(1, 1) * v1 + r(1, 2) * v2;
+    vz_data[i] = r(2, 0) * v0 + r(2, 1) * v1 + r(2, 2) * v2;
+  }
+
+  // Line of sight
+  T * los_x_data = los_x.data();
+  T * los_y_data = los_y.data();
+  for (std::size_t i = begin; i < end; ++i) {
+    const T l0 = los_x_data[i];
+    const T l1 = los_y_data[i];
+    los_x_data[i] = r(0, 0) * l0 + r(0, 1) * l1;
+    los_y_data[i] = r(1, 0) * l0 + r(1, 1) * l1;
+  }
+}
+
+template struct RadarFusionToDetectedObject::BasicRadarBatch<double>;
+template struct RadarFusionToDetectedObject::BasicRadarBatch<float>;
+template void RadarFusionToDetectedObject::BasicRadarBatch<float>::assign(
+  const BasicRadarBatch<double> & other);
+
 RadarFusionToDetectedObject::Output RadarFusionToDetectedObject::update(
   const RadarFusionToDetectedObject::Input & input)
 {
@@ -77,49 +318,243 @@ RadarFusionToDetectedObject::Output RadarFusionToDetectedObject::update(
     return output;
   }
 
-  for (auto & object : input.objects->objects) {
-    // Link between 3d bounding box and radar data
+  const auto & objects = input.objects->objects;
+  const std::size_t chunk_size = fuseObjects(input, objects, output.processing_time);
 
-    std::shared_ptr<std::vector<RadarInput>> radars_within_object =
-      filterRadarWithinObject(object, input.radars);
+  // Merge qualified objects in the order of input objects
+  std::size_t num_outputs = 0;
+  for (auto & result : object_results_) {
+    if (result.is_qualified) {
+      result.output_index = num_outputs++;
+    }
+  }
+  output.objects.objects.resize(num_outputs);
+  thread_pool_->parallelFor(
+    objects.size(), chunk_size,
+    [&](const std::size_t begin, const std::size_t end, const std::size_t thread_index) {
+      LapTimer merge_lap_timer{};
+      for (std::size_t i = begin; i < end; ++i) {
+        const auto & result = object_results_[i];
+        if (!result.is_qualified) {
+          continue;
+        }
+        DetectedObject & output_object = output.objects.objects[result.output_index];
+        output_object = objects[i];
+        annotateObject(result, output_object);
+      }
+      worker_contexts_.at(thread_index)->processing_time.output_ms += merge_lap_timer.lap();
+    });
 
-    // [TODO] (Satoshi Tanaka) Implement
-    // Split the object going in a different direction
-    // std::vector<DetectedObject> split_objects = splitObject(object, radars_within_object);
-    std::vector<DetectedObject> split_objects;
-    split_objects.emplace_back(object);
+  accumulateProcessingTime(output.processing_time);
+  return output;
+}
 
-    for (auto & split_object : split_objects) {
-      // set radars within objects
-      std::shared_ptr<std::vector<RadarInput>> radars_within_split_object;
-      if (split_objects.size() == 1) {
-        // If object is not split, radar data within object is same
-        radars_within_split_object = radars_within_object;
-      } else {
-        // If object is split, then filter radar again
-        radars_within_split_object = filterRadarWithinObject(split_object, radars_within_object);
-      }
+RadarFusionToDetectedObject::ProcessingTime RadarFusionToDetectedObject::update(
+  const RadarFusionToDetectedObject::Input & input, DetectedObjects & objects)
+{
+  ProcessingTime processing_time{};
+  if (objects.objects.empty()) {
+    return processing_time;
+  }
 
-      // Estimate twist of object
-      if (!radars_within_split_object || !(*radars_within_split_object).empty()) {
-        TwistWithCovariance twist_with_covariance =
-          estimateTwist(split_object, radars_within_split_object);
+  fuseObjects(input, objects.objects, processing_time);
 
-        if (isYawCorrect(split_object, twist_with_covariance, param_.threshold_yaw_diff)) {
-          split_object.kinematics.twist_with_covariance = twist_with_covariance;
-          split_object.kinematics.has_twist = true;
-        }
+  // Compact qualified objects to the front by moves, which keeps the order of input objects
+  LapTimer lap_timer{};
+  std::size_t num_outputs = 0;
+  for (std::size_t i = 0; i < objects.objects.size(); ++i) {
+    const auto & result = object_results_[i];
+    if (!result.is_qualified) {
+      continue;
+    }
+    if (num_outputs != i) {
+      objects.objects[num_outputs] = std::move(objects.objects[i]);
+    }
+    annotateObject(result, objects.objects[num_outputs]);
+    ++num_outputs;
+  }
+  objects.objects.erase(objects.objects.begin() + num_outputs, objects.objects.end());
+  processing_time.output_ms += lap_timer.lap();
+
+  accumulateProcessingTime(processing_time);
+  return processing_time;
+}
+
+// Fuse objects with radar data into object_results_, and return the chunk size of threads.
+std::size_t RadarFusionToDetectedObject::fuseObjects(
+  const Input & input, const std::vector<DetectedObject> & objects,
+  ProcessingTime & processing_time)
+{
+  if (param_.use_single_precision) {
+    return fuseObjects(input, objects, radar_batch_f_, processing_time);
+  }
+  return fuseObjects(input, objects, radar_batch_, processing_time);
+}
+
+template <typename T>
+std::size_t RadarFusionToDetectedObject::fuseObjects(
+  const Input & input, const std::vector<DetectedObject> & objects,
+  BasicRadarBatch<T> & radar_batch, ProcessingTime & processing_time)
+{
+  // Each stage is accumulated by laps so that a clock is read once per stage boundary
+  LapTimer lap_timer{};
+
+  // Pack radar data into structure-of-arrays once per cycle.
+  // The batch given by the caller is used as it is unless it is modified by compensation or
+  // converted to float.
+  const BasicRadarBatch<T> * packed_radar_batch = &radar_batch;
+  if (input.radar_batch) {
+    if constexpr (std::is_same_v<T, double>) {
+      if (param_.compensate_radar_motion) {
+        radar_batch = *input.radar_batch;
+      } else {
+        packed_radar_batch = input.radar_batch.get();
+      }
+    } else {
+      radar_batch.assign(*input.radar_batch);
+    }
+  } else {
+    radar_batch.clear();
+    if (input.radars) {
+      radar_batch.reserve(input.radars->size());
+      for (std::size_t i = 0; i < input.radars->size(); ++i) {
+        radar_batch.push_back(input.radars->at(i), i);
       }
+    }
+  }
 
-      // Delete objects with low probability
-      if (isQualified(split_object, radars_within_split_object)) {
-        split_object.classification.at(0).probability =
-          std::max(split_object.classification.at(0).probability, param_.threshold_probability);
-        output.objects.objects.emplace_back(split_object);
+  // Move radar data to the stamp of objects
+  if (param_.compensate_radar_motion) {
+    if (input.radar_segments) {
+      for (const auto & segment : *input.radar_segments) {
+        compensateRadarMotion(
+          radar_batch, segment.begin, segment.end, segment.time_offset, input.ego_twist);
       }
+    } else {
+      compensateRadarMotion(
+        radar_batch, 0, radar_batch.size(), input.radar_time_offset, input.ego_twist);
     }
   }
-  return output;
+  const BasicRadarBatch<T> & radars = *packed_radar_batch;
+
+  // Build spatial index of radar data once per cycle
+  const RadarGridIndex * grid_index = nullptr;
+  if (param_.use_grid_index) {
+    grid_index_.build(
+      radars.size(),
+      [&radars](const std::size_t i, double & x, double & y) {
+        x = radars.x[i];
+        y = radars.y[i];
+      },
+      param_.grid_cell_size);
+    grid_index = &grid_index_;
+  }
+
+  // Intermediate containers of this cycle are allocated from the arena of each thread.
+  // Scratch buffers of each thread are sized for all radar data up front, because objects are
+  // assigned to threads differently every cycle and the buffers would grow whenever a thread gets
+  // an object with more radar data than before.
+  for (auto & context : worker_contexts_) {
+    context->arena.reset();
+    context->processing_time = ProcessingTime{};
+    if (param_.use_grid_index) {
+      context->grid_candidates.reserve(radars.size());
+    }
+    if (param_.velocity_weight_median > 0.0) {
+      context->median_scratch.reserve(radars.size());
+    }
+    if (param_.convert_doppler_to_twist) {
+      auto & converted_twist = std::get<ConvertedTwist<T>>(context->converted_twists);
+      converted_twist.vx.reserve(radars.size());
+      converted_twist.vy.reserve(radars.size());
+      converted_twist.vz.reserve(radars.size());
+    }
+  }
+  processing_time.input_conversion_ms += lap_timer.lap();
+
+  // Fuse each object with radar data in chunks over threads.
+  // Results are stored per input object, so that the output does not depend on threads.
+  object_results_.resize(objects.size());
+  const std::size_t chunk_size =
+    std::max<std::size_t>(objects.size() / (thread_pool_->getNumThreads() * 4), 1);
+  thread_pool_->parallelFor(
+    objects.size(), chunk_size,
+    [&](const std::size_t begin, const std::size_t end, const std::size_t thread_index) {
+      auto & context = *worker_contexts_.at(thread_index);
+      for (std::size_t i = begin; i < end; ++i) {
+        fuseObject(objects[i], radars, grid_index, context, object_results_[i]);
+      }
+    });
+  return chunk_size;
+}
+
+void RadarFusionToDetectedObject::annotateObject(
+  const ObjectResult & result, DetectedObject & object)
+{
+  if (result.has_twist) {
+    object.kinematics.twist_with_covariance = result.twist_with_covariance;
+    object.kinematics.has_twist = true;
+  }
+  object.classification.at(0).probability =
+    std::max(object.classification.at(0).probability, param_.threshold_probability);
+}
+
+void RadarFusionToDetectedObject::accumulateProcessingTime(ProcessingTime & processing_time)
+{
+  for (const auto & context : worker_contexts_) {
+    processing_time.association_ms += context->processing_time.association_ms;
+    processing_time.qualification_ms += context->processing_time.qualification_ms;
+    processing_time.twist_estimation_ms += context->processing_time.twist_estimation_ms;
+    processing_time.output_ms += context->processing_time.output_ms;
+  }
+}
+
+std::size_t RadarFusionToDetectedObject::getArenaUpstreamAllocationCount() const
+{
+  std::size_t count = 0;
+  for (const auto & context : worker_contexts_) {
+    count += context->arena.getUpstreamAllocationCount();
+  }
+  return count;
+}
+
+// Fuse an object with radar data. This is called from multiple threads with their own context, so
+// that it must not modify members other than context and result.
+template <typename T>
+void RadarFusionToDetectedObject::fuseObject(
+  const DetectedObject & object, const BasicRadarBatch<T> & radars,
+  const RadarGridIndex * grid_index, WorkerContext & context, ObjectResult & result)
+{
+  LapTimer lap_timer{};
+  auto & processing_time = context.processing_time;
+  result = ObjectResult{};
+
+  // Link between 3d bounding box and radar data
+  RadarIndices radars_within_object{context.arena.resource()};
+  filterRadarWithinObject(object, radars, grid_index, context, radars_within_object);
+  processing_time.association_ms += lap_timer.lap();
+
+  // [TODO] (Satoshi Tanaka) Implement
+  // Split the object going in a different direction, and fuse each split object with radar data
+  // filtered again from radars_within_object by filterRadarWithinObject().
+  // std::vector<DetectedObject> split_objects =
+  //   splitObject(object, radars, radars_within_object);
+
+  // Delete objects with low probability
+  result.is_qualified = isQualified(object, radars_within_object);
+  processing_time.qualification_ms += lap_timer.lap();
+  if (!result.is_qualified) {
+    return;
+  }
+
+  // Estimate twist of object
+  if (!radars_within_object.empty()) {
+    result.twist_with_covariance =
+      estimateTwist(object, radars, radars_within_object, context);
+    result.has_twist =
+      isYawCorrect(object, result.twist_with_covariance, param_.threshold_yaw_diff);
+  }
+  processing_time.twist_estimation_ms += lap_timer.lap();
 }
 
 // Judge whether object's yaw is same direction with twist's yaw.
@@ -131,7 +566,7 @@ bool RadarFusionToDetectedObject::isYawCorrect(
   const double twist_yaw = tier4_autoware_utils::normalizeRadian(
     std::atan2(twist_with_covariance.twist.linear.y, twist_with_covariance.twist.linear.x));
   const double object_yaw = tier4_autoware_utils::normalizeRadian(
-    tf2::getYaw(object.kinematics.pose_with_covariance.pose.orientation));
+    getYaw(object.kinematics.pose_with_covariance.pose.orientation));
   const double diff_yaw = tier4_autoware_utils::normalizeRadian(twist_yaw - object_yaw);
   if (std::abs(diff_yaw) < yaw_threshold) {
     return true;
@@ -142,33 +577,106 @@ bool RadarFusionToDetectedObject::isYawCorrect(
   }
 }
 
+// Extrapolate radar positions in [begin, end) to the stamp of objects with the twist of each radar
+// data.
+// If ego twist is given, radar data is also moved from the ego vehicle frame at the radar stamp to
+// the one at the objects stamp. In this case, the twist of radar data has to be over-ground
+// velocity.
+template <typename T>
+void RadarFusionToDetectedObject::compensateRadarMotion(
+  BasicRadarBatch<T> & radars, const std::size_t begin, const std::size_t end,
+  const double time_offset, const std::shared_ptr<Twist> & ego_twist)
+{
+  T * x = radars.x.data();
+  T * y = radars.y.data();
+  T * vx = radars.vx.data();
+  T * vy = radars.vy.data();
+  T * los_x = radars.los_x.data();
+  T * los_y = radars.los_y.data();
+
+  const T dt = static_cast<T>(time_offset);
+  for (std::size_t i = begin; i < end; ++i) {
+    x[i] += vx[i] * dt;
+    y[i] += vy[i] * dt;
+  }
+
+  if (!ego_twist) {
+    return;
+  }
+
+  // Rigid transform from the ego frame at the radar stamp to the ego frame at the objects stamp
+  const double ego_yaw = ego_twist->angular.z * time_offset;
+  const T cos_yaw = static_cast<T>(std::cos(ego_yaw));
+  const T sin_yaw = static_cast<T>(std::sin(ego_yaw));
+  const T ego_x = static_cast<T>(ego_twist->linear.x * time_offset);
+  const T ego_y = static_cast<T>(ego_twist->linear.y * time_offset);
+  for (std::size_t i = begin; i < end; ++i) {
+    const T dx = x[i] - ego_x;
+    const T dy = y[i] - ego_y;
+    x[i] = cos_yaw * dx + sin_yaw * dy;
+    y[i] = cos_yaw * dy - sin_yaw * dx;
+    const T rotated_vx = cos_yaw * vx[i] + sin_yaw * vy[i];
+    const T rotated_vy = cos_yaw * vy[i] - sin_yaw * vx[i];
+    vx[i] = rotated_vx;
+    vy[i] = rotated_vy;
+    const T rotated_los_x = cos_yaw * los_x[i] + sin_yaw * los_y[i];
+    const T rotated_los_y = cos_yaw * los_y[i] - sin_yaw * los_x[i];
+    los_x[i] = rotated_los_x;
+    los_y[i] = rotated_los_y;
+  }
+}
+
 // Choose radar pointcloud/objects within 3D bounding box from lidar-base detection with margin
 // space from bird's-eye view.
-std::shared_ptr<std::vector<RadarFusionToDetectedObject::RadarInput>>
-RadarFusionToDetectedObject::filterRadarWithinObject(
-  const DetectedObject & object,
-  const std::shared_ptr<std::vector<RadarFusionToDetectedObject::RadarInput>> & radars)
-{
-  std::vector<RadarInput> outputs{};
-
-  tier4_autoware_utils::Point2d object_size{object.shape.dimensions.x, object.shape.dimensions.y};
-  LinearRing2d object_box = createObject2dWithMargin(object_size, param_.bounding_box_margin);
-  object_box = tier4_autoware_utils::transformVector(
-    object_box, tier4_autoware_utils::pose2transform(object.kinematics.pose_with_covariance.pose));
-
-  for (const auto & radar : (*radars)) {
-    Point2d radar_point{
-      radar.pose_with_covariance.pose.position.x, radar.pose_with_covariance.pose.position.y};
-    if (boost::geometry::within(radar_point, object_box)) {
-      outputs.emplace_back(radar);
-    }
+// If grid_index built from radars is given, only radar data in the grid cells overlapped by the
+// bounding box is checked. The result is same as checking all radar data.
+template <typename T>
+void RadarFusionToDetectedObject::filterRadarWithinObject(
+  const DetectedObject & object, const BasicRadarBatch<T> & radars,
+  const RadarGridIndex * grid_index, RadarIndices & outputs)
+{
+  filterRadarWithinObject(object, radars, grid_index, *worker_contexts_.front(), outputs);
+}
+
+template <typename T>
+void RadarFusionToDetectedObject::filterRadarWithinObject(
+  const DetectedObject & object, const BasicRadarBatch<T> & radars,
+  const RadarGridIndex * grid_index, WorkerContext & context, RadarIndices & outputs)
+{
+  auto & candidates = context.grid_candidates;
+  const OrientedBox2d object_box = createObjectBox(object);
+
+  outputs.clear();
+  if (grid_index) {
+    double half_size_x{};
+    double half_size_y{};
+    getEnvelopeHalfSize(object_box, half_size_x, half_size_y);
+    grid_index->queryCandidates(
+      object_box.center_x - half_size_x, object_box.center_y - half_size_y,
+      object_box.center_x + half_size_x, object_box.center_y + half_size_y, candidates);
+    filterPointsWithinBox(
+      object_box, radars.x.data(), radars.y.data(), candidates.data(), candidates.size(),
+      outputs);
+  } else {
+    filterPointsWithinBox(object_box, radars.x.data(), radars.y.data(), radars.size(), outputs);
   }
-  return std::make_shared<std::vector<RadarFusionToDetectedObject::RadarInput>>(outputs);
+}
+
+// Choose radar data within 3D bounding box from the candidates.
+template <typename T>
+void RadarFusionToDetectedObject::filterRadarWithinObject(
+  const DetectedObject & object, const BasicRadarBatch<T> & radars,
+  const RadarIndices & candidates, RadarIndices & outputs)
+{
+  outputs.clear();
+  filterPointsWithinBox(
+    createObjectBox(object), radars.x.data(), radars.y.data(), candidates.data(),
+    candidates.size(), outputs);
 }
 
 // [TODO] (Satoshi Tanaka) Implementation
 // std::vector<DetectedObject> RadarFusionToDetectedObject::splitObject(
-//   const DetectedObject & object, const std::vector<RadarInput> & radars)
+//   const DetectedObject & object, const RadarBatch & radars, const RadarIndices & indices)
 // {
 //   std::vector<DetectedObject> output{};
 //   return output;
@@ -177,103 +685,245 @@ RadarFusionToDetectedObject::filterRadarWithinObject(
 // Estimate twist from chosen radar pointcloud/objects using twist and target value
 // (Target value is amplitude if using radar pointcloud. Target value is probability if using radar
 // objects).
+template <typename T>
 TwistWithCovariance RadarFusionToDetectedObject::estimateTwist(
-  const DetectedObject & object, std::shared_ptr<std::vector<RadarInput>> & radars)
+  const DetectedObject & object, const BasicRadarBatch<T> & radars, const RadarIndices & indices)
 {
-  if (!radars || (*radars).empty()) {
+  return estimateTwist(object, radars, indices, *worker_contexts_.front());
+}
+
+template <typename T>
+TwistWithCovariance RadarFusionToDetectedObject::estimateTwist(
+  const DetectedObject & object, const BasicRadarBatch<T> & radars,
+  const RadarIndices & radar_indices, WorkerContext & context)
+{
+  if (radar_indices.empty()) {
     TwistWithCovariance output{};
     return output;
   }
 
-  // calculate twist for radar data with min distance
-  Eigen::Vector2d vec_min_distance(0.0, 0.0);
-  if (param_.velocity_weight_min_distance > 0.0) {
-    auto comp_func = [&](const RadarInput & a, const RadarInput & b) {
-      return tier4_autoware_utils::calcSquaredDistance2d(
-               a.pose_with_covariance.pose.position,
-               object.kinematics.pose_with_covariance.pose.position) <
-             tier4_autoware_utils::calcSquaredDistance2d(
-               b.pose_with_covariance.pose.position,
-               object.kinematics.pose_with_covariance.pose.position);
-    };
-    auto iter = std::min_element(std::begin(*radars), std::end(*radars), comp_func);
-    TwistWithCovariance twist_min_distance = iter->twist_with_covariance;
-    vec_min_distance = toVector2d(twist_min_distance);
-  }
-
-  // calculate twist for radar data with median twist
-  Eigen::Vector2d vec_median(0.0, 0.0);
-  if (param_.velocity_weight_median > 0.0) {
-    auto ascending_func = [&](const RadarInput & a, const RadarInput & b) {
-      return getTwistNorm(a.twist_with_covariance.twist) <
-             getTwistNorm(b.twist_with_covariance.twist);
-    };
-    std::sort((*radars).begin(), (*radars).end(), ascending_func);
-
-    if ((*radars).size() % 2 == 1) {
-      int median_index = ((*radars).size() - 1) / 2;
-      vec_median = toVector2d((*radars).at(median_index).twist_with_covariance);
-    } else {
-      int median_index = (*radars).size() / 2;
-      Eigen::Vector2d v1 = toVector2d((*radars).at(median_index - 1).twist_with_covariance);
-      Eigen::Vector2d v2 = toVector2d((*radars).at(median_index).twist_with_covariance);
-      vec_median = (v1 + v2) / 2.0;
-    }
+  // Recover full velocity from doppler velocity of all radar data if the line of sight is spread
+  Vector2<T> least_squares_twist(T{0}, T{0});
+  if (
+    param_.use_doppler_least_squares &&
+    estimateTwistByDopplerLeastSquares(radars, radar_indices, least_squares_twist)) {
+    return toTwistWithCovariance(least_squares_twist);
   }
 
-  // calculate twist for radar data with average twist
-  Eigen::Vector2d vec_average(0.0, 0.0);
-  if (param_.velocity_weight_average > 0.0) {
-    for (const auto & radar : (*radars)) {
-      vec_average += toVector2d(radar.twist_with_covariance);
+  // Use twist converted from doppler velocity if enabled.
+  // If no radar data can be converted, the twist of radar data is used as it is.
+  VelocityColumns<T> velocity{radars.vx.data(), radars.vy.data(), radars.vz.data()};
+  RadarIndices converted_indices{context.arena.resource()};
+  if (param_.convert_doppler_to_twist) {
+    convertDopplerToTwist(object, radars, radar_indices, context, converted_indices);
+    if (!converted_indices.empty()) {
+      const auto & converted_twist = std::get<ConvertedTwist<T>>(context.converted_twists);
+      velocity.vx = converted_twist.vx.data();
+      velocity.vy = converted_twist.vy.data();
+      velocity.vz = converted_twist.vz.data();
     }
-    vec_average /= (*radars).size();
-  }
-
-  // calculate twist for radar data with top target value
-  Eigen::Vector2d vec_top_target_value(0.0, 0.0);
-  if (param_.velocity_weight_target_value_top > 0.0) {
-    auto comp_func = [](const RadarInput & a, const RadarInput & b) {
-      return a.target_value < b.target_value;
-    };
-    auto iter = std::max_element(std::begin((*radars)), std::end((*radars)), comp_func);
-    vec_top_target_value = toVector2d(iter->twist_with_covariance);
-  }
-
-  // calculate twist for radar data with target_value * average
-  Eigen::Vector2d vec_target_value_average(0.0, 0.0);
-  double sum_target_value = 0.0;
-  if (param_.velocity_weight_target_value_average > 0.0) {
-    for (const auto & radar : (*radars)) {
-      vec_target_value_average += (toVector2d(radar.twist_with_covariance) * radar.target_value);
-      sum_target_value += radar.target_value;
+  }
+  const RadarIndices & indices = converted_indices.empty() ? radar_indices : converted_indices;
+
+  return toTwistWithCovariance(
+    (this->*getWeightedTwistEstimator<T>())(object, radars, velocity, indices, context));
+}
+
+template <typename T>
+RadarFusionToDetectedObject::WeightedTwistEstimator<T>
+RadarFusionToDetectedObject::getWeightedTwistEstimator() const
+{
+  if constexpr (std::is_same_v<T, float>) {
+    return estimate_weighted_twist_f_;
+  } else {
+    return estimate_weighted_twist_;
+  }
+}
+
+// Weighted sum of twist estimated by the strategies in the bitmask. Statistics of unused strategies
+// are not calculated, so that the loop over radar data is specialized for each configuration.
+template <typename T, unsigned int Strategies>
+RadarFusionToDetectedObject::Vector2<T> RadarFusionToDetectedObject::estimateWeightedTwist(
+  const DetectedObject & object, const BasicRadarBatch<T> & radars,
+  const VelocityColumns<T> & velocity, const RadarIndices & indices, WorkerContext & context)
+{
+  constexpr bool use_min_distance = (Strategies & MIN_DISTANCE) != 0;
+  constexpr bool use_median = (Strategies & MEDIAN) != 0;
+  constexpr bool use_average = (Strategies & AVERAGE) != 0;
+  constexpr bool use_target_value_top = (Strategies & TARGET_VALUE_TOP) != 0;
+  constexpr bool use_target_value_average = (Strategies & TARGET_VALUE_AVERAGE) != 0;
+
+  // calculate statistics of radar data in a single pass:
+  // radar data with min distance, radar data with top target value, sum of twist,
+  // and sum of twist weighted with target value
+  const auto & object_position = object.kinematics.pose_with_covariance.pose.position;
+  const T object_x = static_cast<T>(object_position.x);
+  const T object_y = static_cast<T>(object_position.y);
+  auto calc_squared_distance = [&](const std::size_t index) {
+    const T dx = radars.x[index] - object_x;
+    const T dy = radars.y[index] - object_y;
+    return dx * dx + dy * dy;
+  };
+  std::size_t min_distance_index = indices.front();
+  T min_squared_distance{0};
+  if constexpr (use_min_distance) {
+    min_squared_distance = calc_squared_distance(min_distance_index);
+  }
+  std::size_t top_target_value_index = indices.front();
+  T top_target_value = radars.target_value[top_target_value_index];
+  Vector2<T> sum_twist(T{0}, T{0});
+  Vector2<T> sum_target_value_twist(T{0}, T{0});
+  T sum_target_value{0};
+  if constexpr (
+    use_min_distance || use_average || use_target_value_top || use_target_value_average) {
+    for (const auto index : indices) {
+      if constexpr (use_min_distance) {
+        const T squared_distance = calc_squared_distance(index);
+        if (squared_distance < min_squared_distance) {
+          min_squared_distance = squared_distance;
+          min_distance_index = index;
+        }
+      }
+      if constexpr (use_target_value_top) {
+        if (top_target_value < radars.target_value[index]) {
+          top_target_value = radars.target_value[index];
+          top_target_value_index = index;
+        }
+      }
+      if constexpr (use_average) {
+        sum_twist += toVector2d(velocity, index);
+      }
+      if constexpr (use_target_value_average) {
+        sum_target_value_twist += toVector2d(velocity, index) * radars.target_value[index];
+        sum_target_value += radars.target_value[index];
+      }
     }
-    vec_target_value_average /= sum_target_value;
   }
 
-  Eigen::Vector2d sum_vec = vec_min_distance * param_.velocity_weight_min_distance +
-                            vec_median * param_.velocity_weight_median +
-                            vec_average * param_.velocity_weight_average +
-                            vec_top_target_value * param_.velocity_weight_target_value_top +
-                            vec_target_value_average * param_.velocity_weight_target_value_average;
-  TwistWithCovariance estimated_twist_with_covariance = toTwistWithCovariance(sum_vec);
+  // Weighted sum in the order of min distance, median, average, top target value and target value
+  // weighted average
+  Vector2<T> sum_vec(T{0}, T{0});
+  if constexpr (use_min_distance) {
+    sum_vec += toVector2d(velocity, min_distance_index) *
+               static_cast<T>(param_.velocity_weight_min_distance);
+  }
+  if constexpr (use_median) {
+    sum_vec +=
+      calcMedianTwist(velocity, indices, context) * static_cast<T>(param_.velocity_weight_median);
+  }
+  if constexpr (use_average) {
+    sum_vec += sum_twist / static_cast<T>(indices.size()) *
+               static_cast<T>(param_.velocity_weight_average);
+  }
+  if constexpr (use_target_value_top) {
+    sum_vec += toVector2d(velocity, top_target_value_index) *
+               static_cast<T>(param_.velocity_weight_target_value_top);
+  }
+  if constexpr (use_target_value_average) {
+    sum_vec += sum_target_value_twist / sum_target_value *
+               static_cast<T>(param_.velocity_weight_target_value_average);
+  }
+  return sum_vec;
+}
 
-  // [TODO] (Satoshi Tanaka) Implement
-  // Convert doppler velocity to twist
-  // if (param_.convert_doppler_to_twist) {
-  //   twist_with_covariance = convertDopplerToTwist(object, twist_with_covariance);
-  // }
-  return estimated_twist_with_covariance;
+template <typename T, std::size_t... Masks>
+std::array<RadarFusionToDetectedObject::WeightedTwistEstimator<T>, sizeof...(Masks)>
+RadarFusionToDetectedObject::makeWeightedTwistEstimators(std::index_sequence<Masks...>)
+{
+  return {{&RadarFusionToDetectedObject::estimateWeightedTwist<T, Masks>...}};
+}
+
+// Estimate velocity v of the object from doppler velocity d_i = v * los_i of radar data by least
+// squares. The 2x2 normal equation (sum los_i los_i^T) v = sum d_i los_i is accumulated in a single
+// pass. If the line of sight of radar data is not spread enough, the normal matrix is
+// ill-conditioned and the velocity is not estimated.
+// The sums are accumulated in the scalar type of radar data, and the 2x2 system is solved in double
+// because the determinant cancels.
+template <typename T>
+bool RadarFusionToDetectedObject::estimateTwistByDopplerLeastSquares(
+  const BasicRadarBatch<T> & radars, const RadarIndices & indices, Vector2<T> & twist)
+{
+  if (indices.size() < 2) {
+    return false;
+  }
+
+  const T * los_x = radars.los_x.data();
+  const T * los_y = radars.los_y.data();
+  const T * doppler = radars.doppler.data();
+  T sum_xx_t{0};
+  T sum_xy_t{0};
+  T sum_yy_t{0};
+  T sum_xd_t{0};
+  T sum_yd_t{0};
+  for (const auto index : indices) {
+    sum_xx_t += los_x[index] * los_x[index];
+    sum_xy_t += los_x[index] * los_y[index];
+    sum_yy_t += los_y[index] * los_y[index];
+    sum_xd_t += los_x[index] * doppler[index];
+    sum_yd_t += los_y[index] * doppler[index];
+  }
+  const double sum_xx = sum_xx_t;
+  const double sum_xy = sum_xy_t;
+  const double sum_yy = sum_yy_t;
+  const double sum_xd = sum_xd_t;
+  const double sum_yd = sum_yd_t;
+
+  // Eigenvalues of the symmetric normal matrix
+  const double half_trace = (sum_xx + sum_yy) / 2.0;
+  const double determinant = sum_xx * sum_yy - sum_xy * sum_xy;
+  const double discriminant = std::sqrt(std::max(half_trace * half_trace - determinant, 0.0));
+  const double max_eigenvalue = half_trace + discriminant;
+  const double min_eigenvalue = half_trace - discriminant;
+  if (
+    !(min_eigenvalue > 0.0) ||
+    min_eigenvalue < param_.threshold_doppler_condition * max_eigenvalue) {
+    return false;
+  }
+
+  const double twist_x = (sum_yy * sum_xd - sum_xy * sum_yd) / determinant;
+  const double twist_y = (sum_xx * sum_yd - sum_xy * sum_xd) / determinant;
+  twist.x() = static_cast<T>(twist_x);
+  twist.y() = static_cast<T>(twist_y);
+  return std::isfinite(twist.x()) && std::isfinite(twist.y());
+}
+
+// Median of twist ordered by the norm.
+// Squared norms are calculated once into the scratch buffer, and the median is chosen by selection
+// instead of sorting all radar data. If the number of radar data is even, the lower median is the
+// max of the lower half after the selection.
+template <typename T>
+RadarFusionToDetectedObject::Vector2<T> RadarFusionToDetectedObject::calcMedianTwist(
+  const VelocityColumns<T> & velocity, const RadarIndices & indices, WorkerContext & context)
+{
+  auto & norms = context.median_scratch;
+  norms.clear();
+  for (const auto index : indices) {
+    const T squared_norm = velocity.vx[index] * velocity.vx[index] +
+                           velocity.vy[index] * velocity.vy[index] +
+                           velocity.vz[index] * velocity.vz[index];
+    norms.emplace_back(squared_norm, index);
+  }
+  auto ascending_func = [](const auto & a, const auto & b) { return a.first < b.first; };
+
+  const auto median_iter = norms.begin() + norms.size() / 2;
+  std::nth_element(norms.begin(), median_iter, norms.end(), ascending_func);
+  if (norms.size() % 2 == 1) {
+    return toVector2d(velocity, median_iter->second);
+  }
+  const auto lower_iter = std::max_element(norms.begin(), median_iter, ascending_func);
+  Vector2<T> v1 = toVector2d(velocity, lower_iter->second);
+  Vector2<T> v2 = toVector2d(velocity, median_iter->second);
+  return (v1 + v2) / T{2};
 }
 
 // Judge whether low confidence objects that do not have some radar points/objects or not.
 bool RadarFusionToDetectedObject::isQualified(
-  const DetectedObject & object, std::shared_ptr<std::vector<RadarInput>> & radars)
+  const DetectedObject & object, const RadarIndices & indices)
 {
   if (object.classification[0].probability > param_.threshold_probability) {
     return true;
   } else {
-    if (!radars || !(*radars).empty()) {
+    if (!indices.empty()) {
       return true;
     } else {
       return false;
@@ -281,23 +931,58 @@ bool RadarFusionToDetectedObject::isQualified(
   }
 }
 
-// [TODO] (Satoshi Tanaka) Implement for radar pointcloud fusion
-// TwistWithCovariance RadarFusionToDetectedObject::convertDopplerToTwist(
-//   const DetectedObject & object, const TwistWithCovariance & twist_with_covariance)
-// {
-//   return twist_with_covariance;
-// }
+// Convert doppler velocity of radar data within the object to twist along the heading of the
+// object. Doppler velocity is the object velocity projected on the line of sight, so that the speed
+// along the heading is doppler velocity divided by the projection of the heading on the line of
+// sight. All radar data of the object are converted in a pass over the columns, and the twist is
+// written to the scratch columns of the context at the same index as the batch.
+template <typename T>
+void RadarFusionToDetectedObject::convertDopplerToTwist(
+  const DetectedObject & object, const BasicRadarBatch<T> & radars, const RadarIndices & indices,
+  WorkerContext & context, RadarIndices & converted_indices)
+{
+  const double yaw = getYaw(object.kinematics.pose_with_covariance.pose.orientation);
+  const T cos_yaw = static_cast<T>(std::cos(yaw));
+  const T sin_yaw = static_cast<T>(std::sin(yaw));
+
+  auto & converted_twist = std::get<ConvertedTwist<T>>(context.converted_twists);
+  if (converted_twist.vx.size() < radars.size()) {
+    converted_twist.vx.resize(radars.size());
+    converted_twist.vy.resize(radars.size());
+    converted_twist.vz.resize(radars.size());
+  }
+  T * vx = converted_twist.vx.data();
+  T * vy = converted_twist.vy.data();
+  T * vz = converted_twist.vz.data();
+  const T * los_x = radars.los_x.data();
+  const T * los_y = radars.los_y.data();
+  const T * doppler = radars.doppler.data();
+
+  converted_indices.clear();
+  converted_indices.reserve(indices.size());
+  for (const auto index : indices) {
+    const T projection = cos_yaw * los_x[index] + sin_yaw * los_y[index];
+    if (std::abs(projection) < static_cast<T>(min_doppler_projection)) {
+      continue;
+    }
+    const T speed = doppler[index] / projection;
+    vx[index] = speed * cos_yaw;
+    vy[index] = speed * sin_yaw;
+    vz[index] = T{0};
+    converted_indices.push_back(index);
+  }
+}
 
-Eigen::Vector2d RadarFusionToDetectedObject::toVector2d(
-  const TwistWithCovariance & twist_with_covariance)
+template <typename T>
+RadarFusionToDetectedObject::Vector2<T> RadarFusionToDetectedObject::toVector2d(
+  const VelocityColumns<T> & velocity, const std::size_t index)
 {
-  auto vec = twist_with_covariance.twist.linear;
-  Eigen::Vector2d output(vec.x, vec.y);
+  Vector2<T> output(velocity.vx[index], velocity.vy[index]);
   return output;
 }
 
-TwistWithCovariance RadarFusionToDetectedObject::toTwistWithCovariance(
-  const Eigen::Vector2d & vector2d)
+template <typename T>
+TwistWithCovariance RadarFusionToDetectedObject::toTwistWithCovariance(const Vector2<T> & vector2d)
 {
   TwistWithCovariance output{};
   output.twist.linear.x = vector2d(0);
@@ -305,29 +990,26 @@ TwistWithCovariance RadarFusionToDetectedObject::toTwistWithCovariance(
   return output;
 }
 
-double RadarFusionToDetectedObject::getTwistNorm(const Twist & twist)
+// Bird's-eye view bounding box of object extended with margin
+OrientedBox2d RadarFusionToDetectedObject::createObjectBox(const DetectedObject & object)
 {
-  double output = std::sqrt(
-    twist.linear.x * twist.linear.x + twist.linear.y * twist.linear.y +
-    twist.linear.z * twist.linear.z);
-  return output;
+  const auto & pose = object.kinematics.pose_with_covariance.pose;
+  return createOrientedBox2d(
+    pose.position.x, pose.position.y, getYaw(pose.orientation), object.shape.dimensions.x,
+    object.shape.dimensions.y, param_.bounding_box_margin);
 }
 
-LinearRing2d RadarFusionToDetectedObject::createObject2dWithMargin(
-  const Point2d object_size, const double margin)
-{
-  const double x_front = object_size.x() / 2.0 + margin;
-  const double x_rear = -object_size.x() / 2.0 - margin;
-  const double y_left = object_size.y() / 2.0 + margin;
-  const double y_right = -object_size.y() / 2.0 - margin;
-
-  LinearRing2d box{};
-  box.push_back(Point2d{x_front, y_left});
-  box.push_back(Point2d{x_front, y_right});
-  box.push_back(Point2d{x_rear, y_right});
-  box.push_back(Point2d{x_rear, y_left});
-  box.push_back(Point2d{x_front, y_left});
-
-  return box;
-}
+// Stages of update() used for benchmarking
+template void RadarFusionToDetectedObject::filterRadarWithinObject(
+  const DetectedObject & object, const BasicRadarBatch<double> & radars,
+  const RadarGridIndex * grid_index, RadarIndices & outputs);
+template void RadarFusionToDetectedObject::filterRadarWithinObject(
+  const DetectedObject & object, const BasicRadarBatch<float> & radars,
+  const RadarGridIndex * grid_index, RadarIndices & outputs);
+template TwistWithCovariance RadarFusionToDetectedObject::estimateTwist(
+  const DetectedObject & object, const BasicRadarBatch<double> & radars,
+  const RadarIndices & indices);
+template TwistWithCovariance RadarFusionToDetectedObject::estimateTwist(
+  const DetectedObject & object, const BasicRadarBatch<float> & radars,
+  const RadarIndices & indices);
 }  // namespace radar_fusion_to_detected_object
@@ -0,0 +1,42 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_object_fusion_to_detected_object/radar_object_fusion_cycle.hpp"
+
+#include <cstddef>
+
+namespace radar_fusion_to_detected_object
+{
+bool RadarObjectFusionCycle::setRadarBatch(
+  const TrackedObjects & radar_objects, RadarFusionToDetectedObject::RadarBatch & radar_batch)
+{
+  radar_batch.clear();
+  radar_batch.reserve(radar_objects.objects.size());
+  for (std::size_t i = 0; i < radar_objects.objects.size(); ++i) {
+    radar_batch.push_back(setRadarInput(radar_objects.objects.at(i), radar_objects.header), i);
+  }
+  return true;
+}
+
+RadarFusionToDetectedObject::RadarInput RadarObjectFusionCycle::setRadarInput(
+  const TrackedObject & radar_object, const std_msgs::msg::Header & header_)
+{
+  RadarFusionToDetectedObject::RadarInput output{};
+  output.pose_with_covariance = &radar_object.kinematics.pose_with_covariance;
+  output.twist_with_covariance = &radar_object.kinematics.twist_with_covariance;
+  output.target_value = radar_object.classification.at(0).probability;
+  output.header = &header_;
+  return output;
+}
+}  // namespace radar_fusion_to_detected_object
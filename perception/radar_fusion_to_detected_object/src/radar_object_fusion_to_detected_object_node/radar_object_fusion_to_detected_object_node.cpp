@@ -16,9 +16,12 @@
 #include "radar_object_fusion_to_detected_object/radar_object_fusion_to_detected_object_node.hpp"
 
 #include "rclcpp/rclcpp.hpp"
+#include "tf2_ros/qos.hpp"
 
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace std::literals;
@@ -27,26 +30,6 @@ using std::chrono::duration_cast;
 using std::chrono::nanoseconds;
 using std::placeholders::_1;
 
-namespace
-{
-template <class T>
-bool update_param(
-  const std::vector<rclcpp::Parameter> & params, const std::string & name, T & value)
-{
-  const auto itr = std::find_if(
-    params.cbegin(), params.cend(),
-    [&name](const rclcpp::Parameter & p) { return p.get_name() == name; });
-
-  // Not found
-  if (itr == params.cend()) {
-    return false;
-  }
-
-  value = itr->template get_value<T>();
-  return true;
-}
-}  // namespace
-
 namespace radar_fusion_to_detected_object
 {
 using autoware_auto_perception_msgs::msg::DetectedObject;
@@ -61,61 +44,150 @@ RadarObjectFusionToDetectedObjectNode::RadarObjectFusionToDetectedObjectNode(
   set_param_res_ = this->add_on_set_parameters_callback(
     std::bind(&RadarObjectFusionToDetectedObjectNode::onSetParam, this, _1));
 
-  // Node Parameter
-  node_param_.update_rate_hz = declare_parameter<double>("node_params.update_rate_hz", 10.0);
-
-  // Core Parameter
-  core_param_.bounding_box_margin =
-    declare_parameter<double>("core_params.bounding_box_margin", 0.5);
-  core_param_.split_threshold_velocity =
-    declare_parameter<double>("core_params.split_threshold_velocity", 0.0);
-  core_param_.threshold_yaw_diff =
-    declare_parameter<double>("core_params.threshold_yaw_diff", 0.35);
-  core_param_.velocity_weight_min_distance =
-    declare_parameter<double>("core_params.velocity_weight_min_distance", 1.0);
-  core_param_.velocity_weight_average =
-    declare_parameter<double>("core_params.velocity_weight_average", 0.0);
-  core_param_.velocity_weight_median =
-    declare_parameter<double>("core_params.velocity_weight_median", 0.0);
-  core_param_.velocity_weight_target_value_average =
-    declare_parameter<double>("core_params.velocity_weight_target_value_average", 0.0);
-  core_param_.velocity_weight_target_value_top =
-    declare_parameter<double>("core_params.velocity_weight_target_value_top", 1.0);
-  core_param_.convert_doppler_to_twist =
-    declare_parameter<bool>("core_params.convert_doppler_to_twist", false);
-  core_param_.threshold_probability =
-    declare_parameter<float>("core_params.threshold_probability", 0.0);
+  // Parameter
+  declareParams(*this, node_param_, core_param_);
 
   // Core
-  radar_fusion_to_detected_object_ = std::make_unique<RadarFusionToDetectedObject>(get_logger());
-  radar_fusion_to_detected_object_->setParam(core_param_);
+  RadarObjectFusionCycle::Param cycle_param{};
+  cycle_param.num_radars = node_param_.radar_input_topics.size();
+  cycle_param.radar_buffer_size = static_cast<std::size_t>(node_param_.radar_buffer_size);
+  cycle_param.stamp_tolerance_sec = node_param_.stamp_tolerance_sec;
+  cycle_param.is_object_trigger = node_param_.trigger_mode == "object";
+  cycle_param.use_ego_odometry = node_param_.use_ego_odometry;
+  fusion_cycle_ = std::make_unique<RadarObjectFusionCycle>(cycle_param, tf_buffer_);
+  fusion_cycle_->setCoreParam(core_param_);
+
+  // Callback Group
+  // Each input is received in its own mutually exclusive group, so that it has a single writer.
+  // Fusion runs in the default group with parameter updates, and so does the reception of detected
+  // objects if they trigger fusion.
+  const auto create_input_options = [this]() {
+    rclcpp::SubscriptionOptions options{};
+    options.callback_group = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+    return options;
+  };
+  auto object_options = rclcpp::SubscriptionOptions{};
+  if (node_param_.trigger_mode == "timer") {
+    object_options = create_input_options();
+  }
 
   // Subscriber
   sub_object_ = create_subscription<DetectedObjects>(
     "~/input/objects", rclcpp::QoS{1},
-    std::bind(&RadarObjectFusionToDetectedObjectNode::onDetectedObjects, this, _1));
-  sub_radar_ = create_subscription<TrackedObjects>(
-    "~/input/radars", rclcpp::QoS{1},
-    std::bind(&RadarObjectFusionToDetectedObjectNode::onRadarObjects, this, _1));
+    std::bind(&RadarObjectFusionToDetectedObjectNode::onDetectedObjects, this, _1),
+    object_options);
+  // Radar objects are queued with margin for the fusion delayed by a cycle
+  radar_sensors_.resize(node_param_.radar_input_topics.size());
+  for (std::size_t i = 0; i < radar_sensors_.size(); ++i) {
+    auto & radar_sensor = radar_sensors_.at(i);
+    radar_sensor.queue = std::make_unique<SpscQueue<TrackedObjects::ConstSharedPtr>>(
+      static_cast<std::size_t>(node_param_.radar_buffer_size) * 4);
+    radar_sensor.subscription = create_subscription<TrackedObjects>(
+      node_param_.radar_input_topics.at(i), rclcpp::QoS{1},
+      [this, i](const TrackedObjects::ConstSharedPtr msg) { onRadarObjects(msg, i); },
+      create_input_options());
+  }
+  if (node_param_.use_ego_odometry) {
+    sub_odometry_ = create_subscription<Odometry>(
+      "~/input/odometry", rclcpp::QoS{1},
+      std::bind(&RadarObjectFusionToDetectedObjectNode::onOdometry, this, _1),
+      create_input_options());
+  }
+  // Static transforms are received in the default group, so that the cache is cleared between
+  // fusion cycles
+  sub_tf_static_ = create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf_static", tf2_ros::StaticListenerQoS(),
+    std::bind(&RadarObjectFusionToDetectedObjectNode::onTfStatic, this, _1));
 
   // Publisher
   pub_objects_ = create_publisher<DetectedObjects>("~/output/objects", 1);
+  objects_publisher_ =
+    LoanablePublisher<DetectedObjects>(pub_objects_, node_param_.use_loaned_message);
+  // DetectedObjects has unbounded sequences, which middlewares do not loan
+  if (node_param_.use_loaned_message && !objects_publisher_.isLoanable()) {
+    RCLCPP_WARN(
+      get_logger(), "use_loaned_message is ignored: the middleware cannot loan DetectedObjects");
+  }
+  pub_unmatched_count_ = create_publisher<tier4_debug_msgs::msg::Int64Stamped>(
+    "~/debug/unmatched_objects_count", 1);
+
+  // Debug
+  debug_publisher_ = std::make_unique<FusionDebugPublisher>(*this);
+  updateDebugPeriod();
 
   // Timer
-  const auto update_period_ns = rclcpp::Rate(node_param_.update_rate_hz).period();
-  timer_ = rclcpp::create_timer(
-    this, get_clock(), update_period_ns,
-    std::bind(&RadarObjectFusionToDetectedObjectNode::onTimer, this));
+  if (node_param_.trigger_mode == "timer") {
+    const auto update_period_ns = rclcpp::Rate(node_param_.update_rate_hz).period();
+    timer_ = rclcpp::create_timer(
+      this, get_clock(), update_period_ns,
+      std::bind(&RadarObjectFusionToDetectedObjectNode::onTimer, this));
+  }
+}
+
+void RadarObjectFusionToDetectedObjectNode::declareParams(
+  rclcpp::Node & node, NodeParam & node_param, RadarFusionToDetectedObject::Param & core_param)
+{
+  declareFusionParams(node, node_param, core_param);
+  node_param.radar_input_topics = node.declare_parameter<std::vector<std::string>>(
+    "node_params.radar_input_topics", std::vector<std::string>{"~/input/radars"});
+  if (node_param.radar_input_topics.empty()) {
+    RCLCPP_ERROR(node.get_logger(), "No radar_input_topics. Use ~/input/radars instead.");
+    node_param.radar_input_topics = {"~/input/radars"};
+  }
 }
 
-void RadarObjectFusionToDetectedObjectNode::onDetectedObjects(
-  const DetectedObjects::ConstSharedPtr msg)
+void RadarObjectFusionToDetectedObjectNode::onDetectedObjects(DetectedObjects::UniquePtr msg)
+{
+  objects_handoff_.write(std::move(msg));
+
+  // Fuse with the buffered radar data as soon as detected objects arrive
+  if (node_param_.trigger_mode == "object" && isDataReady()) {
+    fuse();
+  }
+}
+void RadarObjectFusionToDetectedObjectNode::onRadarObjects(
+  const TrackedObjects::ConstSharedPtr msg, const std::size_t radar_index)
+{
+  if (!radar_sensors_.at(radar_index).queue->push(msg)) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000, "Radar objects are dropped: fusion is not keeping up");
+  }
+}
+void RadarObjectFusionToDetectedObjectNode::onOdometry(const Odometry::ConstSharedPtr msg)
 {
-  detected_objects_ = msg;
+  odometry_handoff_.write(msg);
 }
-void RadarObjectFusionToDetectedObjectNode::onRadarObjects(const TrackedObjects::ConstSharedPtr msg)
+void RadarObjectFusionToDetectedObjectNode::onTfStatic(
+  const tf2_msgs::msg::TFMessage::ConstSharedPtr msg)
 {
-  radar_objects_ = msg;
+  // Updated transforms are set before the cache is cleared, so that the old ones are not cached
+  // again before the transform listener sets them
+  for (const auto & transform : msg->transforms) {
+    tf_buffer_.setTransform(transform, get_name(), true);
+  }
+  fusion_cycle_->clearTransformCache();
+}
+
+// Take inputs received since the last call into the data buffer. Called only from fusion.
+void RadarObjectFusionToDetectedObjectNode::receiveInputs()
+{
+  TrackedObjects::ConstSharedPtr radar_objects{};
+  for (std::size_t i = 0; i < radar_sensors_.size(); ++i) {
+    while (radar_sensors_.at(i).queue->pop(radar_objects)) {
+      fusion_cycle_->pushRadar(radar_objects, i);
+    }
+  }
+  if (odometry_handoff_.update()) {
+    fusion_cycle_->setOdometry(odometry_handoff_.front());
+  }
+  if (objects_handoff_.update()) {
+    // Detected objects not published yet are published before replaced by newer ones
+    const auto & pairing = fusion_cycle_->getPairing();
+    if (pairing.hasPendingObjects() && pairing.hasRadar()) {
+      fuse(true);
+    }
+    fusion_cycle_->setObjects(std::move(objects_handoff_.front()));
+  }
 }
 
 rcl_interfaces::msg::SetParametersResult RadarObjectFusionToDetectedObjectNode::onSetParam(
@@ -124,35 +196,12 @@ rcl_interfaces::msg::SetParametersResult RadarObjectFusionToDetectedObjectNode::
   rcl_interfaces::msg::SetParametersResult result;
 
   try {
-    // Node Parameter
-    {
-      auto & p = node_param_;
-
-      // Update params
-      update_param(params, "node_params.update_rate_hz", p.update_rate_hz);
+    updateFusionParams(params, node_param_, core_param_);
+    if (debug_publisher_) {
+      updateDebugPeriod();
     }
-
-    // Core Parameter
-    {
-      // Copy to local variable
-      auto & p = core_param_;
-
-      // Update params
-      update_param(params, "core_params.bounding_box_margin", p.bounding_box_margin);
-      update_param(params, "core_params.split_threshold_velocity", p.split_threshold_velocity);
-      update_param(params, "core_params.threshold_yaw_diff", p.threshold_yaw_diff);
-      update_param(params, "core_params.velocity_weight_average", p.velocity_weight_average);
-      update_param(params, "core_params.velocity_weight_median", p.velocity_weight_median);
-      update_param(
-        params, "core_params.velocity_weight_target_value_average",
-        p.velocity_weight_target_value_average);
-      update_param(
-        params, "core_params.velocity_weight_target_value_top", p.velocity_weight_target_value_top);
-
-      // Set parameter to instance
-      if (radar_fusion_to_detected_object_) {
-        radar_fusion_to_detected_object_->setParam(core_param_);
-      }
+    if (fusion_cycle_) {
+      fusion_cycle_->setCoreParam(core_param_);
     }
   } catch (const rclcpp::exceptions::InvalidParameterTypeException & e) {
     result.successful = false;
@@ -167,23 +216,19 @@ rcl_interfaces::msg::SetParametersResult RadarObjectFusionToDetectedObjectNode::
 
 bool RadarObjectFusionToDetectedObjectNode::isDataReady()
 {
-  if (!detected_objects_) {
+  receiveInputs();
+
+  const auto & pairing = fusion_cycle_->getPairing();
+  if (!pairing.hasObjects()) {
     RCLCPP_INFO_THROTTLE(
       get_logger(), *get_clock(), 1000, "waiting for detected objects data msg...");
     return false;
   }
-  if (!radar_objects_) {
+  if (!pairing.hasRadar()) {
     RCLCPP_INFO_THROTTLE(get_logger(), *get_clock(), 1000, "waiting for radar objects data msg...");
     return false;
   }
 
-  if (detected_objects_->header.frame_id != radar_objects_->header.frame_id) {
-    RCLCPP_WARN_THROTTLE(
-      get_logger(), *get_clock(), 1000,
-      "The frame id between detected objects and radar objects is not same");
-    return false;
-  }
-
   return true;
 }
 
@@ -193,35 +238,84 @@ void RadarObjectFusionToDetectedObjectNode::onTimer()
     return;
   }
 
-  if (radar_objects_->objects.empty()) {
-    pub_objects_->publish(*detected_objects_);
+  fuse();
+}
+
+void RadarObjectFusionToDetectedObjectNode::fuse(const bool force)
+{
+  // Pair detected objects with the radar objects of the nearest stamp of each sensor
+  const auto pair_result = fusion_cycle_->pair(now().nanoseconds(), force);
+  if (pair_result == RadarObjectFusionCycle::Pairing::Result::SKIPPED) {
     return;
   }
+  debug_publisher_->startCycle();
 
-  // Set input data
-  RadarFusionToDetectedObject::Input input{};
-  std::vector<RadarFusionToDetectedObject::RadarInput> radars_{};
-  for (const auto & radar_object_ : radar_objects_->objects) {
-    auto radar_input = setRadarInput(radar_object_, radar_objects_->header);
-    radars_.emplace_back(radar_input);
+  // If no radar objects are within tolerance, detected objects are published without fusion
+  if (pair_result == RadarObjectFusionCycle::Pairing::Result::UNMATCHED) {
+    ++num_unmatched_objects_;
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000,
+      "No radar objects within %f [s] of detected objects. Unmatched count: %ld",
+      node_param_.stamp_tolerance_sec, num_unmatched_objects_);
+    tier4_debug_msgs::msg::Int64Stamped unmatched_count{};
+    unmatched_count.stamp = now();
+    unmatched_count.data = num_unmatched_objects_;
+    pub_unmatched_count_->publish(unmatched_count);
   }
-  input.objects = detected_objects_;
-  input.radars = std::make_shared<std::vector<RadarFusionToDetectedObject::RadarInput>>(radars_);
 
-  // Update
-  output_ = radar_fusion_to_detected_object_->update(input);
-  pub_objects_->publish(output_.objects);
+  // Detected objects are fused in the message to publish
+  const auto & report = fusion_cycle_->fuse(objects_publisher_.borrow());
+  if (pair_result == RadarObjectFusionCycle::Pairing::Result::MATCHED) {
+    if (report.num_untransformed_sensors > 0) {
+      RCLCPP_WARN_THROTTLE(
+        get_logger(), *get_clock(), 1000, "No transform of radar objects: %s",
+        report.transform_error.c_str());
+    }
+    if (report.num_skipped_sensors > 0) {
+      RCLCPP_WARN_THROTTLE(
+        get_logger(), *get_clock(), 1000, "Radar objects of %zu of %zu sensors are not fused",
+        report.num_skipped_sensors, radar_sensors_.size());
+    }
+  }
+  if (report.is_odometry_missing) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000,
+      "Ego motion is not compensated: no odometry in the frame of detected objects");
+  }
+  publishObjects(report.is_fused ? &report.processing_time : nullptr);
 }
 
-RadarFusionToDetectedObject::RadarInput RadarObjectFusionToDetectedObjectNode::setRadarInput(
-  const TrackedObject & radar_object, const std_msgs::msg::Header & header_)
+// Publish the objects written to objects_publisher_.
+// Processing time of fusion stages is recorded only if objects were fused with radar data
+void RadarObjectFusionToDetectedObjectNode::publishObjects(
+  const RadarFusionToDetectedObject::ProcessingTime * processing_time)
 {
-  RadarFusionToDetectedObject::RadarInput output{};
-  output.pose_with_covariance = radar_object.kinematics.pose_with_covariance;
-  output.twist_with_covariance = radar_object.kinematics.twist_with_covariance;
-  output.target_value = radar_object.classification.at(0).probability;
-  output.header = header_;
-  return output;
+  const rclcpp::Time objects_stamp = objects_publisher_.borrow().header.stamp;
+  debug_publisher_->startPublish();
+  objects_publisher_.publish();
+
+  // Radar age is of the oldest sensor
+  std::optional<rclcpp::Time> oldest_radar_stamp{};
+  const auto & pairing = fusion_cycle_->getPairing();
+  for (std::size_t i = 0; i < pairing.getNumRadars(); ++i) {
+    if (const auto & radar_objects = pairing.getRadar(i)) {
+      const rclcpp::Time radar_stamp = radar_objects->header.stamp;
+      if (!oldest_radar_stamp || radar_stamp < *oldest_radar_stamp) {
+        oldest_radar_stamp = radar_stamp;
+      }
+    }
+  }
+  debug_publisher_->endCycle(processing_time, objects_stamp, oldest_radar_stamp);
+}
+
+// The processing time need to be within the update period in the timer mode
+void RadarObjectFusionToDetectedObjectNode::updateDebugPeriod()
+{
+  if (node_param_.trigger_mode == "timer") {
+    debug_publisher_->setUpdatePeriod(1e3 / node_param_.update_rate_hz);
+  } else {
+    debug_publisher_->setUpdatePeriod(std::nullopt);
+  }
 }
 
 }  // namespace radar_fusion_to_detected_object
@@ -0,0 +1,334 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_scan_fusion_to_detected_object/radar_scan_fusion_to_detected_object_node.hpp"
+
+#include "rclcpp/rclcpp.hpp"
+
+#include "sensor_msgs/point_cloud2_iterator.hpp"
+#include "tf2_ros/qos.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::placeholders::_1;
+
+namespace
+{
+// Field of the pointcloud by name. Return nullptr if not found.
+const sensor_msgs::msg::PointField * findField(
+  const sensor_msgs::msg::PointCloud2 & msg, const std::string & name)
+{
+  const auto itr =
+    std::find_if(msg.fields.cbegin(), msg.fields.cend(), [&name](const auto & field) {
+      return field.name == name;
+    });
+  return itr == msg.fields.cend() ? nullptr : &(*itr);
+}
+}  // namespace
+
+namespace radar_fusion_to_detected_object
+{
+RadarScanFusionToDetectedObjectNode::RadarScanFusionToDetectedObjectNode(
+  const rclcpp::NodeOptions & node_options)
+: Node("radar_scan_fusion_to_detected_object", node_options)
+{
+  // Parameter Server
+  set_param_res_ = this->add_on_set_parameters_callback(
+    std::bind(&RadarScanFusionToDetectedObjectNode::onSetParam, this, _1));
+
+  // Parameter
+  declareFusionParams(*this, node_param_, core_param_);
+
+  // Core
+  RadarFusionCycle<PointCloud2>::Param cycle_param{};
+  cycle_param.radar_buffer_size = static_cast<std::size_t>(node_param_.radar_buffer_size);
+  cycle_param.stamp_tolerance_sec = node_param_.stamp_tolerance_sec;
+  cycle_param.is_object_trigger = node_param_.trigger_mode == "object";
+  cycle_param.use_ego_odometry = node_param_.use_ego_odometry;
+  fusion_cycle_ = std::make_unique<RadarFusionCycle<PointCloud2>>(
+    cycle_param, tf_buffer_,
+    [this](const PointCloud2 & radar_scan, RadarFusionToDetectedObject::RadarBatch & radar_batch) {
+      return setRadarBatch(radar_scan, radar_batch);
+    });
+  fusion_cycle_->setCoreParam(core_param_);
+
+  // Callback Group
+  // Each input is received in its own mutually exclusive group, so that radar scans are
+  // deserialized in parallel with fusion under a multi-threaded executor.
+  const auto create_input_options = [this]() {
+    rclcpp::SubscriptionOptions options{};
+    options.callback_group = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+    return options;
+  };
+  auto object_options = rclcpp::SubscriptionOptions{};
+  if (node_param_.trigger_mode == "timer") {
+    object_options = create_input_options();
+  }
+
+  // Subscriber
+  sub_object_ = create_subscription<DetectedObjects>(
+    "~/input/objects", rclcpp::QoS{1},
+    std::bind(&RadarScanFusionToDetectedObjectNode::onDetectedObjects, this, _1), object_options);
+  // Radar scans are queued with margin for the fusion delayed by a cycle
+  radar_queue_ = std::make_unique<SpscQueue<PointCloud2::ConstSharedPtr>>(
+    static_cast<std::size_t>(node_param_.radar_buffer_size) * 4);
+  sub_radar_ = create_subscription<PointCloud2>(
+    "~/input/radars", rclcpp::SensorDataQoS(),
+    std::bind(&RadarScanFusionToDetectedObjectNode::onRadarScan, this, _1),
+    create_input_options());
+  if (node_param_.use_ego_odometry) {
+    sub_odometry_ = create_subscription<Odometry>(
+      "~/input/odometry", rclcpp::QoS{1},
+      std::bind(&RadarScanFusionToDetectedObjectNode::onOdometry, this, _1),
+      create_input_options());
+  }
+  // Static transforms are received in the default group, so that the cache is cleared between
+  // fusion cycles
+  sub_tf_static_ = create_subscription<tf2_msgs::msg::TFMessage>(
+    "/tf_static", tf2_ros::StaticListenerQoS(),
+    std::bind(&RadarScanFusionToDetectedObjectNode::onTfStatic, this, _1));
+
+  // Publisher
+  pub_objects_ = create_publisher<DetectedObjects>("~/output/objects", 1);
+  objects_publisher_ =
+    LoanablePublisher<DetectedObjects>(pub_objects_, node_param_.use_loaned_message);
+  // DetectedObjects has unbounded sequences, which middlewares do not loan
+  if (node_param_.use_loaned_message && !objects_publisher_.isLoanable()) {
+    RCLCPP_WARN(
+      get_logger(), "use_loaned_message is ignored: the middleware cannot loan DetectedObjects");
+  }
+  pub_unmatched_count_ = create_publisher<tier4_debug_msgs::msg::Int64Stamped>(
+    "~/debug/unmatched_objects_count", 1);
+
+  // Debug
+  debug_publisher_ = std::make_unique<FusionDebugPublisher>(*this);
+  updateDebugPeriod();
+
+  // Timer
+  if (node_param_.trigger_mode == "timer") {
+    const auto update_period_ns = rclcpp::Rate(node_param_.update_rate_hz).period();
+    timer_ = rclcpp::create_timer(
+      this, get_clock(), update_period_ns,
+      std::bind(&RadarScanFusionToDetectedObjectNode::onTimer, this));
+  }
+}
+
+void RadarScanFusionToDetectedObjectNode::onDetectedObjects(DetectedObjects::UniquePtr msg)
+{
+  objects_handoff_.write(std::move(msg));
+
+  // Fuse with the buffered radar data as soon as detected objects arrive
+  if (node_param_.trigger_mode == "object" && isDataReady()) {
+    fuse();
+  }
+}
+void RadarScanFusionToDetectedObjectNode::onRadarScan(const PointCloud2::ConstSharedPtr msg)
+{
+  if (!radar_queue_->push(msg)) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000, "Radar scans are dropped: fusion is not keeping up");
+  }
+}
+void RadarScanFusionToDetectedObjectNode::onOdometry(const Odometry::ConstSharedPtr msg)
+{
+  odometry_handoff_.write(msg);
+}
+void RadarScanFusionToDetectedObjectNode::onTfStatic(
+  const tf2_msgs::msg::TFMessage::ConstSharedPtr msg)
+{
+  // Updated transforms are set before the cache is cleared, so that the old ones are not cached
+  // again before the transform listener sets them
+  for (const auto & transform : msg->transforms) {
+    tf_buffer_.setTransform(transform, get_name(), true);
+  }
+  fusion_cycle_->clearTransformCache();
+}
+
+// Take inputs received since the last call into the data buffer. Called only from fusion.
+void RadarScanFusionToDetectedObjectNode::receiveInputs()
+{
+  PointCloud2::ConstSharedPtr radar_scan{};
+  while (radar_queue_->pop(radar_scan)) {
+    fusion_cycle_->pushRadar(radar_scan);
+  }
+  if (odometry_handoff_.update()) {
+    fusion_cycle_->setOdometry(odometry_handoff_.front());
+  }
+  if (objects_handoff_.update()) {
+    // Detected objects not published yet are published before replaced by newer ones
+    const auto & pairing = fusion_cycle_->getPairing();
+    if (pairing.hasPendingObjects() && pairing.hasRadar()) {
+      fuse(true);
+    }
+    fusion_cycle_->setObjects(std::move(objects_handoff_.front()));
+  }
+}
+
+rcl_interfaces::msg::SetParametersResult RadarScanFusionToDetectedObjectNode::onSetParam(
+  const std::vector<rclcpp::Parameter> & params)
+{
+  rcl_interfaces::msg::SetParametersResult result;
+
+  try {
+    updateFusionParams(params, node_param_, core_param_);
+    if (debug_publisher_) {
+      updateDebugPeriod();
+    }
+    if (fusion_cycle_) {
+      fusion_cycle_->setCoreParam(core_param_);
+    }
+  } catch (const rclcpp::exceptions::InvalidParameterTypeException & e) {
+    result.successful = false;
+    result.reason = e.what();
+    return result;
+  }
+
+  result.successful = true;
+  result.reason = "success";
+  return result;
+}
+
+bool RadarScanFusionToDetectedObjectNode::isDataReady()
+{
+  receiveInputs();
+
+  const auto & pairing = fusion_cycle_->getPairing();
+  if (!pairing.hasObjects()) {
+    RCLCPP_INFO_THROTTLE(
+      get_logger(), *get_clock(), 1000, "waiting for detected objects data msg...");
+    return false;
+  }
+  if (!pairing.hasRadar()) {
+    RCLCPP_INFO_THROTTLE(get_logger(), *get_clock(), 1000, "waiting for radar scan data msg...");
+    return false;
+  }
+
+  return true;
+}
+
+void RadarScanFusionToDetectedObjectNode::onTimer()
+{
+  if (!isDataReady()) {
+    return;
+  }
+
+  fuse();
+}
+
+void RadarScanFusionToDetectedObjectNode::fuse(const bool force)
+{
+  // Pair detected objects with the radar scan of the nearest stamp
+  const auto pair_result = fusion_cycle_->pair(now().nanoseconds(), force);
+  if (pair_result == RadarFusionCycle<PointCloud2>::Pairing::Result::SKIPPED) {
+    return;
+  }
+  debug_publisher_->startCycle();
+
+  // If no radar scan is within tolerance, detected objects are published without fusion
+  if (pair_result == RadarFusionCycle<PointCloud2>::Pairing::Result::UNMATCHED) {
+    ++num_unmatched_objects_;
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000,
+      "No radar scan within %f [s] of detected objects. Unmatched count: %ld",
+      node_param_.stamp_tolerance_sec, num_unmatched_objects_);
+    tier4_debug_msgs::msg::Int64Stamped unmatched_count{};
+    unmatched_count.stamp = now();
+    unmatched_count.data = num_unmatched_objects_;
+    pub_unmatched_count_->publish(unmatched_count);
+  }
+
+  // Detected objects are fused in the message to publish.
+  // If the radar scan is invalid or not transformed, they are published without fusion.
+  const auto & report = fusion_cycle_->fuse(objects_publisher_.borrow());
+  if (report.num_untransformed_sensors > 0) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000, "No transform of radar scan: %s",
+      report.transform_error.c_str());
+  }
+  if (report.is_odometry_missing) {
+    RCLCPP_WARN_THROTTLE(
+      get_logger(), *get_clock(), 1000,
+      "Ego motion is not compensated: no odometry in the frame of detected objects");
+  }
+  publishObjects(report.is_fused ? &report.processing_time : nullptr);
+}
+
+// Publish the objects written to objects_publisher_.
+// Processing time of fusion stages is recorded only if objects were fused with radar data
+void RadarScanFusionToDetectedObjectNode::publishObjects(
+  const RadarFusionToDetectedObject::ProcessingTime * processing_time)
+{
+  const rclcpp::Time objects_stamp = objects_publisher_.borrow().header.stamp;
+  debug_publisher_->startPublish();
+  objects_publisher_.publish();
+
+  std::optional<rclcpp::Time> radar_stamp{};
+  if (const auto & radar_scan = fusion_cycle_->getPairing().getRadar()) {
+    radar_stamp = rclcpp::Time(radar_scan->header.stamp);
+  }
+  debug_publisher_->endCycle(processing_time, objects_stamp, radar_stamp);
+}
+
+// The processing time need to be within the update period in the timer mode
+void RadarScanFusionToDetectedObjectNode::updateDebugPeriod()
+{
+  if (node_param_.trigger_mode == "timer") {
+    debug_publisher_->setUpdatePeriod(1e3 / node_param_.update_rate_hz);
+  } else {
+    debug_publisher_->setUpdatePeriod(std::nullopt);
+  }
+}
+
+// The radar scan need to have range, azimuth, doppler and amplitude fields of float32.
+// Amplitude is used as the target value.
+bool RadarScanFusionToDetectedObjectNode::setRadarBatch(
+  const PointCloud2 & radar_scan, RadarFusionToDetectedObject::RadarBatch & radar_batch)
+{
+  for (const auto & name : {"range", "azimuth", "doppler", "amplitude"}) {
+    const auto * field = findField(radar_scan, name);
+    if (!field) {
+      RCLCPP_WARN_THROTTLE(
+        get_logger(), *get_clock(), 1000, "Radar scan does not have the field: %s", name);
+      return false;
+    }
+    if (field->datatype != sensor_msgs::msg::PointField::FLOAT32) {
+      RCLCPP_WARN_THROTTLE(
+        get_logger(), *get_clock(), 1000, "The field of radar scan is not float32: %s", name);
+      return false;
+    }
+  }
+
+  radar_batch.clear();
+  radar_batch.reserve(static_cast<std::size_t>(radar_scan.width) * radar_scan.height);
+  sensor_msgs::PointCloud2ConstIterator<float> iter_range(radar_scan, "range");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_azimuth(radar_scan, "azimuth");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_doppler(radar_scan, "doppler");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_amplitude(radar_scan, "amplitude");
+  for (std::size_t i = 0; iter_range != iter_range.end();
+       ++i, ++iter_range, ++iter_azimuth, ++iter_doppler, ++iter_amplitude) {
+    radar_batch.push_back_polar(*iter_range, *iter_azimuth, *iter_doppler, *iter_amplitude, i);
+  }
+  return true;
+}
+
+}  // namespace radar_fusion_to_detected_object
+
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(
+  radar_fusion_to_detected_object::RadarScanFusionToDetectedObjectNode)
@@ -0,0 +1,129 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_fusion_to_detected_object/thread_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace radar_fusion_to_detected_object
+{
+ThreadPool::ThreadPool(const std::size_t num_threads)
+{
+  const std::size_t num_workers = std::max<std::size_t>(num_threads, 1) - 1;
+  workers_.reserve(num_workers);
+  for (std::size_t i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto & worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(
+  const std::size_t size, const std::size_t chunk_size, ChunkFunc func, void * context)
+{
+  if (size == 0) {
+    return;
+  }
+
+  // Run on the calling thread if there is nothing to share
+  if (workers_.empty() || size <= chunk_size) {
+    func(context, 0, size, 0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    func_ = func;
+    context_ = context;
+    size_ = size;
+    chunk_size_ = std::max<std::size_t>(chunk_size, 1);
+    next_begin_.store(0, std::memory_order_relaxed);
+    num_running_workers_ = workers_.size();
+    exception_ = nullptr;
+    ++generation_;
+  }
+  start_cv_.notify_all();
+
+  runChunks(0);
+
+  std::exception_ptr exception{};
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return num_running_workers_ == 0; });
+    exception = exception_;
+    exception_ = nullptr;
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+void ThreadPool::runChunks(const std::size_t thread_index)
+{
+  while (true) {
+    const std::size_t begin = next_begin_.fetch_add(chunk_size_, std::memory_order_relaxed);
+    if (size_ <= begin) {
+      return;
+    }
+    const std::size_t end = std::min(begin + chunk_size_, size_);
+    try {
+      func_(context_, begin, end, thread_index);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!exception_) {
+        exception_ = std::current_exception();
+      }
+    }
+  }
+}
+
+void ThreadPool::workerLoop(const std::size_t thread_index)
+{
+  std::size_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [&] { return stop_ || generation_ != generation; });
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+
+    runChunks(thread_index);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --num_running_workers_;
+      if (num_running_workers_ == 0) {
+        done_cv_.notify_one();
+      }
+    }
+  }
+}
+}  // namespace radar_fusion_to_detected_object
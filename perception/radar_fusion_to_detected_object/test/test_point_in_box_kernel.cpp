@@ -0,0 +1,263 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_fusion_to_detected_object/point_in_box_kernel.hpp"
+
+#include <boost/geometry.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+using radar_fusion_to_detected_object::createOrientedBox2d;
+using radar_fusion_to_detected_object::filterPointsWithinBox;
+using radar_fusion_to_detected_object::isPointInBoxKernelAvailable;
+using radar_fusion_to_detected_object::OrientedBox2d;
+using radar_fusion_to_detected_object::PointInBoxKernel;
+
+using Point2d = boost::geometry::model::d2::point_xy<double>;
+using Polygon2d = boost::geometry::model::polygon<Point2d>;
+
+struct BoxParam
+{
+  double center_x{};
+  double center_y{};
+  double yaw{};
+  double length{};
+  double width{};
+  double margin{};
+};
+
+// Same rectangle as the previous implementation, which is clockwise and closed
+Polygon2d createPolygon(const BoxParam & param)
+{
+  const double half_length = param.length / 2.0 + param.margin;
+  const double half_width = param.width / 2.0 + param.margin;
+  const double cos_yaw = std::cos(param.yaw);
+  const double sin_yaw = std::sin(param.yaw);
+  const double corners[5][2] = {
+    {half_length, half_width},
+    {half_length, -half_width},
+    {-half_length, -half_width},
+    {-half_length, half_width},
+    {half_length, half_width}};
+
+  Polygon2d polygon{};
+  for (const auto & corner : corners) {
+    polygon.outer().emplace_back(
+      param.center_x + cos_yaw * corner[0] - sin_yaw * corner[1],
+      param.center_y + sin_yaw * corner[0] + cos_yaw * corner[1]);
+  }
+  return polygon;
+}
+
+// Signed distance from the boundary of the box, which is positive inside
+double getDistanceFromBoundary(const BoxParam & param, const double x, const double y)
+{
+  const double dx = x - param.center_x;
+  const double dy = y - param.center_y;
+  const double local_x = std::cos(param.yaw) * dx + std::sin(param.yaw) * dy;
+  const double local_y = std::cos(param.yaw) * dy - std::sin(param.yaw) * dx;
+  return std::min(
+    param.length / 2.0 + param.margin - std::abs(local_x),
+    param.width / 2.0 + param.margin - std::abs(local_y));
+}
+
+// Points uniformly around the box, and on its edges and corners or off them by multiples of step
+template <typename T>
+void createPoints(
+  const BoxParam & param, const std::size_t num_points, const double step, std::mt19937 & engine,
+  std::vector<T> & xs, std::vector<T> & ys)
+{
+  const double half_length = param.length / 2.0 + param.margin;
+  const double half_width = param.width / 2.0 + param.margin;
+  const double range = std::hypot(half_length, half_width) * 1.5;
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::uniform_int_distribution<int> edge(0, 3);
+  std::uniform_int_distribution<int> offset(-2, 2);
+
+  xs.clear();
+  ys.clear();
+  for (std::size_t i = 0; i < num_points; ++i) {
+    double local_x = 0.0;
+    double local_y = 0.0;
+    if (i % 2 == 0) {
+      local_x = uniform(engine) * range;
+      local_y = uniform(engine) * range;
+    } else {
+      // On an edge or a corner, or inside or outside of it
+      const int side = edge(engine);
+      const double along = i % 8 == 1 ? 1.0 : uniform(engine);
+      local_x = side < 2 ? (side == 0 ? half_length : -half_length) : along * half_length;
+      local_y = side < 2 ? along * half_width : (side == 2 ? half_width : -half_width);
+      local_x += offset(engine) * step;
+      local_y += offset(engine) * step;
+    }
+    const double cos_yaw = std::cos(param.yaw);
+    const double sin_yaw = std::sin(param.yaw);
+    xs.push_back(static_cast<T>(param.center_x + cos_yaw * local_x - sin_yaw * local_y));
+    ys.push_back(static_cast<T>(param.center_y + sin_yaw * local_x + cos_yaw * local_y));
+  }
+}
+
+std::vector<PointInBoxKernel> getAvailableKernels()
+{
+  std::vector<PointInBoxKernel> kernels{};
+  for (const auto kernel :
+       {PointInBoxKernel::SCALAR, PointInBoxKernel::AVX2, PointInBoxKernel::NEON}) {
+    if (isPointInBoxKernelAvailable(kernel)) {
+      kernels.push_back(kernel);
+    }
+  }
+  return kernels;
+}
+
+std::string toString(const PointInBoxKernel kernel)
+{
+  switch (kernel) {
+    case PointInBoxKernel::AVX2:
+      return "AVX2";
+    case PointInBoxKernel::NEON:
+      return "NEON";
+    default:
+      return "SCALAR";
+  }
+}
+
+// Compare each kernel with boost::geometry::within on the same points. Points closer to the
+// boundary than tolerance are rounded differently by the rotation of the point and of the polygon,
+// so that they are not compared.
+template <typename T>
+void testRandomBoxes(const double tolerance)
+{
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<double> position(-50.0, 50.0);
+  std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+  std::uniform_real_distribution<double> size(0.5, 10.0);
+  std::uniform_real_distribution<double> margin(0.0, 1.0);
+
+  std::vector<T> xs{};
+  std::vector<T> ys{};
+  std::pmr::vector<std::size_t> indices{};
+  std::size_t num_compared = 0;
+  for (std::size_t i = 0; i < 1000; ++i) {
+    BoxParam param{};
+    param.center_x = position(engine);
+    param.center_y = position(engine);
+    param.yaw = yaw(engine);
+    param.length = size(engine);
+    param.width = size(engine);
+    param.margin = margin(engine);
+    const OrientedBox2d box = createOrientedBox2d(
+      param.center_x, param.center_y, param.yaw, param.length, param.width, param.margin);
+    const Polygon2d polygon = createPolygon(param);
+    // Not a multiple of SIMD width to run the remainder loop
+    createPoints(param, 1021, 2.0 * tolerance, engine, xs, ys);
+
+    std::vector<bool> expected(xs.size());
+    std::vector<bool> is_compared(xs.size());
+    for (std::size_t j = 0; j < xs.size(); ++j) {
+      const double x = static_cast<double>(xs.at(j));
+      const double y = static_cast<double>(ys.at(j));
+      expected.at(j) = boost::geometry::within(Point2d{x, y}, polygon);
+      is_compared.at(j) = tolerance < std::abs(getDistanceFromBoundary(param, x, y));
+    }
+
+    for (const auto kernel : getAvailableKernels()) {
+      indices.clear();
+      filterPointsWithinBox(kernel, box, xs.data(), ys.data(), xs.size(), indices);
+      std::vector<bool> actual(xs.size());
+      for (std::size_t k = 0; k < indices.size(); ++k) {
+        actual.at(indices.at(k)) = true;
+        if (0 < k) {
+          ASSERT_LT(indices.at(k - 1), indices.at(k)) << toString(kernel);
+        }
+      }
+      for (std::size_t j = 0; j < xs.size(); ++j) {
+        if (is_compared.at(j)) {
+          ASSERT_EQ(expected.at(j), actual.at(j))
+            << toString(kernel) << " box " << i << " point (" << xs.at(j) << ", " << ys.at(j)
+            << ")";
+          ++num_compared;
+        }
+      }
+    }
+  }
+  EXPECT_LT(0U, num_compared);
+}
+
+// Boxes and points of dyadic values are exact in both float and double, so that points on the
+// boundary are compared exactly.
+template <typename T>
+void testBoundary()
+{
+  const BoxParam param{1.5, -2.25, 0.0, 4.5, 2.0, 0.25};
+  const OrientedBox2d box = createOrientedBox2d(
+    param.center_x, param.center_y, param.yaw, param.length, param.width, param.margin);
+  const Polygon2d polygon = createPolygon(param);
+
+  // Corners, edges, and inside and outside of them by 1/64 m
+  std::vector<T> xs{};
+  std::vector<T> ys{};
+  for (int ix = -8; ix <= 8; ++ix) {
+    for (int iy = -8; iy <= 8; ++iy) {
+      const double step = 1.0 / 64.0;
+      for (const double dx : {-step, 0.0, step}) {
+        for (const double dy : {-step, 0.0, step}) {
+          xs.push_back(static_cast<T>(param.center_x + ix * 2.5 / 8.0 + dx));
+          ys.push_back(static_cast<T>(param.center_y + iy * 1.25 / 8.0 + dy));
+        }
+      }
+    }
+  }
+
+  std::pmr::vector<std::size_t> indices{};
+  for (const auto kernel : getAvailableKernels()) {
+    indices.clear();
+    filterPointsWithinBox(kernel, box, xs.data(), ys.data(), xs.size(), indices);
+    std::vector<bool> actual(xs.size());
+    for (const auto index : indices) {
+      actual.at(index) = true;
+    }
+    for (std::size_t j = 0; j < xs.size(); ++j) {
+      const Point2d point{static_cast<double>(xs.at(j)), static_cast<double>(ys.at(j))};
+      EXPECT_EQ(boost::geometry::within(point, polygon), actual.at(j))
+        << toString(kernel) << " point (" << xs.at(j) << ", " << ys.at(j) << ")";
+    }
+  }
+}
+}  // namespace
+
+TEST(PointInBoxKernel, AvailableKernels)
+{
+  EXPECT_TRUE(isPointInBoxKernelAvailable(PointInBoxKernel::SCALAR));
+  EXPECT_TRUE(isPointInBoxKernelAvailable(radar_fusion_to_detected_object::getPointInBoxKernel()));
+}
+
+TEST(PointInBoxKernel, RandomBoxesDouble) { testRandomBoxes<double>(1e-9); }
+
+// Float points are rotated in float, whose error is a few ulps of the coordinates up to 60 m
+TEST(PointInBoxKernel, RandomBoxesFloat) { testRandomBoxes<float>(1e-4); }
+
+TEST(PointInBoxKernel, BoundaryDouble) { testBoundary<double>(); }
+
+TEST(PointInBoxKernel, BoundaryFloat) { testBoundary<float>(); }
@@ -0,0 +1,440 @@
+// Copyright 2022 TIER IV, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "radar_fusion_to_detected_object.hpp"
+#include "radar_object_fusion_to_detected_object/radar_object_fusion_cycle.hpp"
+#include "synthetic_scene.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Count allocations from the global allocator over fusion cycles
+namespace
+{
+std::atomic<std::size_t> g_num_allocations{0};
+}  // namespace
+
+// Not inlined so that the compiler does not pair malloc() and free() with new and delete
+__attribute__((noinline)) void * operator new(std::size_t size)
+{
+  g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void * ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+__attribute__((noinline)) void operator delete(void * ptr) noexcept { std::free(ptr); }
+__attribute__((noinline)) void operator delete(void * ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace radar_fusion_to_detected_object
+{
+namespace
+{
+// Parameters of config/radar_object_fusion_to_detected_object.param.yaml with all weights
+RadarFusionToDetectedObject::Param createParam()
+{
+  RadarFusionToDetectedObject::Param param{};
+  param.bounding_box_margin = 2.0;
+  param.split_threshold_velocity = 5.0;
+  param.threshold_yaw_diff = 0.35;
+  param.use_grid_index = true;
+  param.grid_cell_size = 4.0;
+  param.threshold_probability = 0.4f;
+  param.velocity_weight_average = 1.0;
+  param.velocity_weight_median = 1.0;
+  param.velocity_weight_min_distance = 1.0;
+  param.velocity_weight_target_value_average = 1.0;
+  param.velocity_weight_target_value_top = 1.0;
+  return param;
+}
+
+// Weights of velocity estimation in the order of average, median, min distance, target value
+// average and target value top
+using Weights = std::array<double, 5>;
+constexpr Weights weight_configs[] = {
+  {0.0, 0.0, 1.0, 0.0, 0.0}, {0.0, 1.0, 0.0, 0.0, 0.0}, {1.0, 0.0, 0.0, 1.0, 1.0},
+  {1.0, 1.0, 1.0, 1.0, 1.0}, {0.0, 0.0, 1.0, 0.0, 1.0},
+};
+
+void setWeights(const Weights & weights, RadarFusionToDetectedObject::Param & param)
+{
+  param.velocity_weight_average = weights[0];
+  param.velocity_weight_median = weights[1];
+  param.velocity_weight_min_distance = weights[2];
+  param.velocity_weight_target_value_average = weights[3];
+  param.velocity_weight_target_value_top = weights[4];
+}
+
+// Objects fused in the same way have the same order, twists and probabilities bit by bit
+void expectSameObjects(
+  const std::vector<DetectedObject> & expected, const std::vector<DetectedObject> & actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    const auto & expected_kinematics = expected[i].kinematics;
+    const auto & actual_kinematics = actual[i].kinematics;
+    const auto & expected_position = expected_kinematics.pose_with_covariance.pose.position;
+    const auto & actual_position = actual_kinematics.pose_with_covariance.pose.position;
+    EXPECT_EQ(expected_position.x, actual_position.x) << "object " << i;
+    EXPECT_EQ(expected_position.y, actual_position.y) << "object " << i;
+    ASSERT_EQ(expected_kinematics.has_twist, actual_kinematics.has_twist) << "object " << i;
+    const auto & expected_twist = expected_kinematics.twist_with_covariance;
+    const auto & actual_twist = actual_kinematics.twist_with_covariance;
+    EXPECT_EQ(expected_twist.twist.linear.x, actual_twist.twist.linear.x) << "object " << i;
+    EXPECT_EQ(expected_twist.twist.linear.y, actual_twist.twist.linear.y) << "object " << i;
+    EXPECT_EQ(expected_twist.twist.linear.z, actual_twist.twist.linear.z) << "object " << i;
+    EXPECT_EQ(expected_twist.covariance, actual_twist.covariance) << "object " << i;
+    EXPECT_EQ(
+      expected[i].classification.at(0).probability, actual[i].classification.at(0).probability)
+      << "object " << i;
+  }
+}
+
+struct AllocationCase
+{
+  std::string name{};
+  bool use_grid_index{};
+  bool use_single_precision{};
+  bool use_radar_scan{};
+  int num_threads{1};
+  bool use_ego_twist{};
+};
+
+// Radar objects of the radar data in the scene
+TrackedObjects createRadarObjects(const SyntheticScene & scene)
+{
+  TrackedObjects radar_objects{};
+  radar_objects.header = scene.radar_header;
+  radar_objects.objects.resize(scene.input.radars->size());
+  for (std::size_t i = 0; i < radar_objects.objects.size(); ++i) {
+    auto & radar_object = radar_objects.objects.at(i);
+    radar_object.kinematics.pose_with_covariance = scene.radar_poses.at(i);
+    radar_object.kinematics.twist_with_covariance = scene.radar_twists.at(i);
+    radar_object.classification.resize(1);
+    radar_object.classification.at(0).probability =
+      static_cast<float>(scene.input.radars->at(i).target_value);
+  }
+  return radar_objects;
+}
+}  // namespace
+
+// Intermediate containers of update() are allocated from the arena and reused over cycles, so
+// that the in-place update does not allocate after warm-up cycles.
+TEST(RadarFusionToDetectedObject, NoAllocationInSteadyState)
+{
+  constexpr std::size_t num_warm_up_cycles = 3;
+  constexpr std::size_t num_cycles = 20;
+  const AllocationCase cases[] = {
+    {"default", true, false, false, 1}, {"no_grid", false, false, false, 1},
+    {"single", true, true, false, 1},   {"scan", true, false, true, 1},
+    {"threads", true, false, false, 4}, {"ego_twist", true, false, false, 1, true},
+  };
+
+  for (const auto & c : cases) {
+    SCOPED_TRACE(c.name);
+    SceneParam scene_param{};
+    scene_param.seed = 42;
+    scene_param.num_objects = 200;
+    scene_param.num_radars = 2000;
+    scene_param.cluster_ratio = 0.9;
+    scene_param.use_radar_scan = c.use_radar_scan;
+    const auto scene = generateSyntheticScene(scene_param);
+
+    auto param = createParam();
+    param.use_grid_index = c.use_grid_index;
+    param.use_single_precision = c.use_single_precision;
+    param.convert_doppler_to_twist = c.use_radar_scan;
+    param.num_threads = c.num_threads;
+    param.compensate_radar_motion = c.use_ego_twist;
+    RadarFusionToDetectedObject fusion;
+    fusion.setParam(param);
+
+    // Ego twist is assigned to the same message every cycle, as RadarFusionCycle does
+    auto input = scene->input;
+    if (c.use_ego_twist) {
+      input.radar_time_offset = 0.05;
+      input.ego_twist = std::make_shared<Twist>();
+      input.ego_twist->linear.x = 10.0;
+      input.ego_twist->angular.z = 0.1;
+    }
+
+    // Objects are refilled out of the counted region, as a node receiving a new message
+    DetectedObjects objects{};
+    for (std::size_t i = 0; i < num_warm_up_cycles; ++i) {
+      objects = *scene->input.objects;
+      fusion.update(input, objects);
+    }
+
+    std::size_t num_allocations = 0;
+    std::size_t num_arena_upstream_allocations = 0;
+    std::size_t num_fused_objects = 0;
+    for (std::size_t i = 0; i < num_cycles; ++i) {
+      objects = *scene->input.objects;
+      const std::size_t num_allocations_start = g_num_allocations.load();
+      if (c.use_ego_twist) {
+        input.ego_twist->linear.x += 0.1;
+      }
+      fusion.update(input, objects);
+      num_allocations += g_num_allocations.load() - num_allocations_start;
+      num_arena_upstream_allocations += fusion.getArenaUpstreamAllocationCount();
+      num_fused_objects += objects.objects.size();
+    }
+    EXPECT_EQ(0U, num_allocations);
+    EXPECT_EQ(0U, num_arena_upstream_allocations);
+    EXPECT_LT(0U, num_fused_objects);
+  }
+}
+
+// The fusion cycle reuses radar data and the ego twist over cycles, so that pairing and fusion do
+// not allocate after warm-up cycles. New messages are received out of the counted region.
+TEST(RadarObjectFusionCycle, NoAllocationInSteadyState)
+{
+  constexpr std::size_t num_warm_up_cycles = 3;
+  constexpr std::size_t num_cycles = 20;
+  constexpr int64_t period_ns = 100'000'000;
+  SceneParam scene_param{};
+  scene_param.seed = 42;
+  scene_param.num_objects = 200;
+  scene_param.num_radars = 2000;
+  scene_param.cluster_ratio = 0.9;
+  const auto scene = generateSyntheticScene(scene_param);
+  const auto radar_objects = createRadarObjects(*scene);
+
+  auto param = createParam();
+  param.compensate_radar_motion = true;
+  RadarObjectFusionCycle::Param cycle_param{};
+  cycle_param.radar_buffer_size = 10;
+  cycle_param.stamp_tolerance_sec = 0.1;
+  cycle_param.use_ego_odometry = true;
+  tf2::BufferCore tf_buffer{};
+  RadarObjectFusionCycle fusion_cycle(cycle_param, tf_buffer);
+  fusion_cycle.setCoreParam(param);
+
+  auto odometry = std::make_shared<nav_msgs::msg::Odometry>();
+  odometry->child_frame_id = scene->input.objects->header.frame_id;
+  odometry->twist.twist.linear.x = 10.0;
+  odometry->twist.twist.angular.z = 0.1;
+  fusion_cycle.setOdometry(odometry);
+
+  std::size_t num_allocations = 0;
+  std::size_t num_fused_objects = 0;
+  DetectedObjects objects{};
+  for (std::size_t i = 0; i < num_warm_up_cycles + num_cycles; ++i) {
+    // Radar objects are 50 ms older than detected objects
+    const int64_t stamp_ns = static_cast<int64_t>(i + 1) * period_ns;
+    auto radar = std::make_shared<TrackedObjects>(radar_objects);
+    radar->header.stamp.sec = static_cast<int32_t>((stamp_ns - period_ns / 2) / 1'000'000'000);
+    radar->header.stamp.nanosec =
+      static_cast<uint32_t>((stamp_ns - period_ns / 2) % 1'000'000'000);
+    auto detected_objects = std::make_shared<DetectedObjects>(*scene->input.objects);
+    detected_objects->header.stamp.sec = static_cast<int32_t>(stamp_ns / 1'000'000'000);
+    detected_objects->header.stamp.nanosec = static_cast<uint32_t>(stamp_ns % 1'000'000'000);
+    fusion_cycle.pushRadar(radar);
+    fusion_cycle.setObjects(detected_objects);
+    radar.reset();
+    detected_objects.reset();
+
+    const std::size_t num_allocations_start = g_num_allocations.load();
+    const auto pair_result = fusion_cycle.pair(stamp_ns, true);
+    const auto & report = fusion_cycle.fuse(objects);
+    if (num_warm_up_cycles <= i) {
+      num_allocations += g_num_allocations.load() - num_allocations_start;
+    }
+    ASSERT_EQ(RadarObjectFusionCycle::Pairing::Result::MATCHED, pair_result);
+    ASSERT_TRUE(report.is_fused);
+    ASSERT_FALSE(report.is_odometry_missing);
+    num_fused_objects += objects.objects.size();
+  }
+  EXPECT_EQ(0U, num_allocations);
+  EXPECT_LT(0U, num_fused_objects);
+}
+
+// The grid index only skips radar data outside of the cells overlapped by objects and keeps the
+// order of radar data, so that the output is identical to checking all radar data. Sparse scenes
+// and small cells enlarge the cells, and objects at the edge of the scene query cells clamped to
+// the grid.
+TEST(RadarFusionToDetectedObject, GridIndexEquivalence)
+{
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<std::size_t> num_objects(1, 100);
+  std::uniform_int_distribution<std::size_t> num_radars(1, 2000);
+  std::uniform_int_distribution<std::size_t> num_sparse_radars(1, 10);
+  std::uniform_real_distribution<double> cluster_ratio(0.0, 1.0);
+  std::uniform_real_distribution<double> extent(10.0, 1000.0);
+  const double cell_sizes[] = {0.5, 4.0, 50.0};
+
+  std::size_t num_fused_objects = 0;
+  for (unsigned int seed = 0; seed < 100; ++seed) {
+    SCOPED_TRACE("seed " + std::to_string(seed));
+    SceneParam scene_param{};
+    scene_param.seed = seed;
+    scene_param.num_objects = num_objects(engine);
+    // A quarter of scenes have a few radar data over the whole scene
+    scene_param.num_radars = seed % 4 == 0 ? num_sparse_radars(engine) : num_radars(engine);
+    scene_param.cluster_ratio = cluster_ratio(engine);
+    scene_param.extent = extent(engine);
+    scene_param.use_radar_scan = seed % 2 == 1;
+    const auto scene = generateSyntheticScene(scene_param);
+
+    auto param = createParam();
+    setWeights(weight_configs[seed % std::size(weight_configs)], param);
+    param.convert_doppler_to_twist = scene_param.use_radar_scan;
+    param.grid_cell_size = cell_sizes[seed % std::size(cell_sizes)];
+    param.use_grid_index = false;
+    RadarFusionToDetectedObject fusion;
+    fusion.setParam(param);
+    const auto expected = fusion.update(scene->input).objects.objects;
+    param.use_grid_index = true;
+    fusion.setParam(param);
+    const auto actual = fusion.update(scene->input).objects.objects;
+
+    expectSameObjects(expected, actual);
+    num_fused_objects += expected.size();
+  }
+  EXPECT_LT(0U, num_fused_objects);
+}
+
+// Objects are fused into results per input object and merged in the input order, so that the
+// output does not depend on the number of threads nor on which thread fuses which object.
+TEST(RadarFusionToDetectedObject, ThreadsDeterminism)
+{
+  constexpr std::size_t num_cycles = 5;
+  const int thread_counts[] = {2, 3, 8, 0};
+  for (unsigned int seed = 0; seed < 10; ++seed) {
+    SCOPED_TRACE("seed " + std::to_string(seed));
+    SceneParam scene_param{};
+    scene_param.seed = seed;
+    scene_param.num_objects = 200;
+    scene_param.num_radars = 2000;
+    scene_param.cluster_ratio = 0.9;
+    scene_param.use_radar_scan = seed % 2 == 1;
+    const auto scene = generateSyntheticScene(scene_param);
+
+    auto param = createParam();
+    setWeights(weight_configs[seed % std::size(weight_configs)], param);
+    param.convert_doppler_to_twist = scene_param.use_radar_scan;
+    param.use_single_precision = seed % 4 >= 2;
+    param.num_threads = 1;
+    RadarFusionToDetectedObject fusion;
+    fusion.setParam(param);
+    const auto expected = fusion.update(scene->input).objects.objects;
+    ASSERT_FALSE(expected.empty());
+
+    for (const int num_threads : thread_counts) {
+      SCOPED_TRACE("threads " + std::to_string(num_threads));
+      param.num_threads = num_threads;
+      fusion.setParam(param);
+      // Chunks are taken by threads in a different order every cycle
+      for (std::size_t i = 0; i < num_cycles; ++i) {
+        expectSameObjects(expected, fusion.update(scene->input).objects.objects);
+        DetectedObjects objects = *scene->input.objects;
+        fusion.update(scene->input, objects);
+        expectSameObjects(expected, objects.objects);
+      }
+    }
+  }
+}
+
+// Radar data in float deviates from double by rounding, which must not change the output more than
+// 1 cm and 1 cm/s over seeded scenes of all weight configurations.
+TEST(RadarFusionToDetectedObject, SinglePrecisionAccuracy)
+{
+  constexpr double max_position_error = 0.01;
+  constexpr double max_twist_error = 0.01;
+  for (unsigned int seed = 0; seed < 20; ++seed) {
+    SceneParam scene_param{};
+    scene_param.seed = seed;
+    scene_param.num_objects = 100;
+    scene_param.num_radars = 2000;
+    scene_param.cluster_ratio = 0.9;
+    // Objects in the map frame are far from the origin, where float is coarser
+    scene_param.extent = seed < 10 ? 100.0 : 1000.0;
+    scene_param.use_radar_scan = seed % 2 == 1;
+    const auto scene = generateSyntheticScene(scene_param);
+    for (const auto & weights : weight_configs) {
+      SCOPED_TRACE(
+        "seed " + std::to_string(seed) + " weights " + std::to_string(&weights - weight_configs));
+      auto param = createParam();
+      setWeights(weights, param);
+      param.convert_doppler_to_twist = scene_param.use_radar_scan;
+      RadarFusionToDetectedObject fusion;
+      fusion.setParam(param);
+      const auto expected = fusion.update(scene->input).objects.objects;
+      param.use_single_precision = true;
+      fusion.setParam(param);
+      const auto actual = fusion.update(scene->input).objects.objects;
+
+      ASSERT_EQ(expected.size(), actual.size());
+      for (std::size_t i = 0; i < expected.size(); ++i) {
+        const auto & expected_kinematics = expected[i].kinematics;
+        const auto & actual_kinematics = actual[i].kinematics;
+        ASSERT_EQ(expected_kinematics.has_twist, actual_kinematics.has_twist) << "object " << i;
+        const auto & expected_position = expected_kinematics.pose_with_covariance.pose.position;
+        const auto & actual_position = actual_kinematics.pose_with_covariance.pose.position;
+        EXPECT_LE(
+          std::hypot(
+            expected_position.x - actual_position.x, expected_position.y - actual_position.y),
+          max_position_error)
+          << "object " << i;
+        const auto & expected_linear = expected_kinematics.twist_with_covariance.twist.linear;
+        const auto & actual_linear = actual_kinematics.twist_with_covariance.twist.linear;
+        EXPECT_LE(
+          std::hypot(expected_linear.x - actual_linear.x, expected_linear.y - actual_linear.y),
+          max_twist_error)
+          << "object " << i;
+      }
+    }
+  }
+}
+
+// Radar data transformed from a radar frame into the map frame in float, as the nodes do once per
+// sensor, stays within 1 cm and 1 cm/s of double.
+TEST(RadarFusionToDetectedObject, SinglePrecisionTransform)
+{
+  SceneParam scene_param{};
+  scene_param.seed = 42;
+  scene_param.num_radars = 2000;
+  const auto scene = generateSyntheticScene(scene_param);
+  const Eigen::Isometry3d transform = Eigen::Translation3d(3000.0, -2000.0, 0.6) *
+                                      Eigen::AngleAxisd(M_PI / 3.0, Eigen::Vector3d::UnitZ());
+
+  auto expected = scene->radar_batch;
+  expected.transform(transform, 0, expected.size());
+  RadarFusionToDetectedObject::BasicRadarBatch<float> actual{};
+  actual.assign(scene->radar_batch);
+  actual.transform(transform, 0, actual.size());
+
+  ASSERT_EQ(expected.size(), actual.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_LE(std::hypot(expected.x[i] - actual.x[i], expected.y[i] - actual.y[i]), 0.01);
+    EXPECT_LE(std::hypot(expected.vx[i] - actual.vx[i], expected.vy[i] - actual.vy[i]), 0.01);
+  }
+}
+}  // namespace radar_fusion_to_detected_object